@@ -0,0 +1,168 @@
+// substring search against glibc and the other hot paths against naive versions, build with `make bench`
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "yasli.h"
+
+#define HAY_SIZE   ((size_t)64 << 20)
+#define ITERATIONS 5
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// what a case insensitive search costs without str_ifind
+static int64_t find_lowered(const string_t* src, const char* needle) {
+    str_t lower_src = str_strdup(src);
+    str_t lower_needle = str_new_string(needle);
+    str_to_lower(lower_src);
+    str_to_lower(lower_needle);
+    int64_t index = str_find(lower_src, str_cstr(lower_needle), 1);
+    str_free(lower_src);
+    str_free(lower_needle);
+    return index;
+}
+
+// the byte at a time fnv-1a that str_hash replaces
+static uint64_t fnv1a(const char* src, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)src[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// throughput of search in GB/s, the needle sits at the very end of hay
+#define BENCH(label, search)                                                \
+    do {                                                                    \
+        double start = now();                                               \
+        size_t found = 0;                                                   \
+        for (int i = 0; i < ITERATIONS; i++) {                              \
+            found += (search);                                              \
+        }                                                                   \
+        double elapsed = now() - start;                                     \
+        printf("  %-10s %6.2f GB/s%s\n", label, ITERATIONS * HAY_SIZE / elapsed / 1e9, found == ITERATIONS ? "" : "  (missed)"); \
+    } while (0)
+
+int main(void) {
+    // text over a small alphabet, so first and last bytes of the needle show up often
+    str_builder_t* builder = str_builder_new();
+    unsigned seed = 12345;
+    for (size_t i = 0; i < HAY_SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        str_builder_append_char(builder, "abcdefgh ,."[(seed >> 16) % 11]);
+    }
+    str_t hay = str_builder_build(builder);
+    str_builder_free(builder);
+
+    size_t lengths[] = {2, 4, 8, 16, 32, 64};
+    for (size_t n = 0; n < sizeof(lengths) / sizeof(lengths[0]); n++) {
+        // a needle that cannot appear in the random text, placed at the end
+        char needle[65];
+        for (size_t i = 0; i < lengths[n]; i++) {
+            needle[i] = "abcdefgh"[i % 8];
+        }
+        needle[lengths[n] - 1] = 'z';
+        needle[lengths[n]] = 0;
+        str_t temp = str_substr(hay, 0, HAY_SIZE - lengths[n]);
+        str_append_cstr(&temp, needle);
+        // volatile keeps the compiler from hoisting the pure libc calls out of the loop
+        const char* volatile cstr = str_cstr(temp);
+
+        printf("needle length %zu\n", lengths[n]);
+        str_searcher_t* searcher = str_searcher_new(needle);
+        BENCH("str_find", str_find(temp, needle, 1) >= 0);
+        BENCH("searcher", str_searcher_find(searcher, str_view(temp)) >= 0);
+        BENCH("strstr", strstr(cstr, needle) != NULL);
+        BENCH("memmem", memmem(cstr, HAY_SIZE, needle, lengths[n]) != NULL);
+        str_searcher_free(searcher);
+        str_free(temp);
+    }
+
+    // case insensitive search against lowering a copy of both sides first
+    str_t mixed = str_substr(hay, 0, HAY_SIZE - 16);
+    str_append_cstr(&mixed, "AbCdEfGhAbCdEfGz");
+    printf("case insensitive, needle length 16\n");
+    BENCH("str_ifind", str_ifind(mixed, "abcdefghABCDEFGZ", 1) >= 0);
+    BENCH("lowered", find_lowered(mixed, "abcdefghABCDEFGZ") >= 0);
+    str_free(mixed);
+
+    // hashing the whole text, and many short keys cut out of it
+    printf("hashing %zu MB\n", HAY_SIZE >> 20);
+    BENCH("str_hash", str_hash(hay) != 0);
+    BENCH("fnv-1a", fnv1a(str_cstr(hay), HAY_SIZE) != 0);
+    enum { KEYS = 1 << 20, KEY_SIZE = 12 };
+    str_t* keys = malloc(sizeof(str_t) * KEYS);
+    for (size_t k = 0; k < KEYS; k++) {
+        keys[k] = str_substr(hay, k * KEY_SIZE, KEY_SIZE);
+    }
+    printf("hashing %d keys of %d bytes\n", KEYS, KEY_SIZE);
+    uint64_t sum = 0;
+    double start = now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        for (size_t k = 0; k < KEYS; k++) {
+            sum += str_hash(keys[k]);
+        }
+    }
+    printf("  %-10s %6.2f ns/key\n", "str_hash", (now() - start) / ITERATIONS / KEYS * 1e9);
+    start = now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        for (size_t k = 0; k < KEYS; k++) {
+            sum += fnv1a(str_cstr(keys[k]), str_strlen(keys[k]));
+        }
+    }
+    printf("  %-10s %6.2f ns/key\n", "fnv-1a", (now() - start) / ITERATIONS / KEYS * 1e9);
+    // keeps the sums from being optimized away
+    volatile uint64_t sink = sum;
+    (void)sink;
+    for (size_t k = 0; k < KEYS; k++) {
+        str_free(keys[k]);
+    }
+    free(keys);
+
+    // replacing many keywords at once against one str_replaced per keyword
+    enum { KEYWORDS = 100 };
+    char keywords[KEYWORDS][7];
+    const char* old_vals[KEYWORDS + 1];
+    const char* new_vals[KEYWORDS];
+    for (size_t k = 0; k < KEYWORDS; k++) {
+        for (size_t i = 0; i < 6; i++) {
+            seed = seed * 1103515245 + 12345;
+            keywords[k][i] = "abcdefgh"[(seed >> 16) % 8];
+        }
+        keywords[k][6] = 0;
+        old_vals[k] = keywords[k];
+        new_vals[k] = "KEYWORD";
+    }
+    old_vals[KEYWORDS] = NULL;
+    str_t text = str_substr(hay, 0, HAY_SIZE / 4);
+    printf("replacing %d keywords in %zu MB\n", KEYWORDS, HAY_SIZE / 4 >> 20);
+
+    start = now();
+    str_multi_t* multi = str_multi_new(old_vals);
+    str_t once = str_replaced_any(multi, text, new_vals);
+    printf("  %-16s %6.3f s\n", "str_replaced_any", now() - start);
+    str_multi_free(multi);
+
+    start = now();
+    str_t chained = str_strdup(text);
+    for (size_t k = 0; k < KEYWORDS; k++) {
+        str_t temp = str_replaced(chained, old_vals[k], new_vals[k]);
+        str_free(chained);
+        chained = temp;
+    }
+    printf("  %-16s %6.3f s\n", "str_replaced", now() - start);
+    // chaining can replace text that an earlier replacement created, so the
+    // results only agree when no keyword overlaps another
+    printf("  same result: %s\n", str_streq(once, chained) ? "yes" : "no");
+    str_free(once);
+    str_free(chained);
+    str_free(text);
+    str_free(hay);
+    return 0;
+}
@@ -41,6 +41,47 @@ int main(void) {
     printf("%zu, %s\n", str_strlen(str5), str_cstr(str5));
     printf("%s, %s\n", p_bool(str_start_with(str5, "lol")), p_bool(str_end_with(str5, " World")));
 
+    // a regex is compiled once and then used on as many strings as needed
+    str_regex_t* re = str_regex_new("[0-9]+ms");
+    str_t timings = str_new_string("took 12ms, 345ms and 6ms");
+    size_t count;
+    str_view_t* matches = str_regex_find_all(re, timings, &count);
+    printf("\nregex matches: %zu\n", count);
+    for (size_t i = 0; i < count; i++) {
+        printf("%.*s\n", (int)matches[i].length, matches[i].data);
+    }
+    str_t masked = str_regex_replaced(re, timings, "?ms");
+    printf("%s\n", str_cstr(masked));
+    str_free(matches);
+    str_frees(timings, masked, NULL);
+    str_regex_free(re);
+
+    // a glob is compiled the same way, str_glob_match compiles it for one test
+    str_glob_t* glob = str_glob_new("*.[ch]");
+    str_t file = str_new_string("src/yasli.c");
+    printf("\nglob: %s, %s\n", p_bool(str_glob_test(glob, str_view(file))), p_bool(str_glob_match(file, "*/*.md")));
+    str_free(file);
+    str_glob_free(glob);
+
+    // the case insensitive search folds ascii letters only
+    printf("\nignoring case: %lld, %s\n", (long long)str_ifind(str, "WORLD", 1), p_bool(str_ihas(str, "hello world")));
+
+    // edit distances and similarity count bytes
+    str_t kitten = str_new_string("kitten");
+    str_t sitting = str_new_string("sitting");
+    printf("\nedit distance: %zu, %zu, %.3f\n", str_levenshtein(kitten, sitting), str_damerau(kitten, sitting), str_jaro_winkler(kitten, sitting));
+    str_frees(kitten, sitting, NULL);
+
+    // approximate search finds a needle with at most k edits
+    str_t typos = str_new_string("we will recieve the pakage tomorow");
+    size_t length;
+    int64_t index = str_find_approx(typos, "tomorrow", 1, 0, &length);
+    printf("\napproximate: %.*s\n", (int)length, str_cstr(typos) + index);
+    str_view_t* words = str_find_approx_all(typos, "package", 1, &count);
+    printf("%zu, %.*s\n", count, (int)words[0].length, words[0].data);
+    str_free(words);
+    str_free(typos);
+
     wchar_t* wstr = str_wstr(str);
     wprintf(L"%ls", wstr);
     // not necessary if define USE_GC
@@ -1,7 +1,39 @@
 #include "yasli.h"
 
+#include <limits.h>
+
 #ifdef _MSC_VER
 #    define _CRT_SECURE_NO_WARNINGS 1
+#    define YASLI_TLS               __declspec(thread)
+#else
+#    define YASLI_TLS _Thread_local
+#endif  // _MSC_VER
+
+// vector kernels are picked at compile time, build with -mavx2 for the wide ones
+#if defined(__AVX2__)
+#    include <immintrin.h>
+#    define STR_AVX2 1
+#    define STR_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define STR_SSE2 1
+#endif  // __AVX2__
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+static inline unsigned str_ctz(uint32_t mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+}
+static inline unsigned str_clz(uint32_t mask) {
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return 31 - index;
+}
+#else
+#    define str_ctz(mask) ((unsigned)__builtin_ctz(mask))
+#    define str_clz(mask) ((unsigned)__builtin_clz(mask))
 #endif  // _MSC_VER
 
 #define STB_SPRINTF_IMPLEMENTATION
@@ -13,8 +45,43 @@
 #    define malloc(size)       GC_malloc(size)
 #    define realloc(ptr, size) GC_realloc(ptr, size)
 #    define free(ptr)          (void)ptr
+// the collector already recycles memory, a pool on top of it only holds on to it
+#    undef YASLI_POOL
+#endif  // YASLI_GC
+
+#ifdef YASLI_REFCOUNT
+#    ifndef __STDC_NO_ATOMICS__
+#        include <stdatomic.h>
+typedef atomic_size_t str_refs_t;
+#    else
+// without atomics sharing a string between threads is not safe
+typedef size_t str_refs_t;
+#        define atomic_init(refs, val)     (*(refs) = (val))
+#        define atomic_load(refs)          (*(refs))
+#        define atomic_fetch_add(refs, val) ((*(refs) += (val)) - (val))
+#        define atomic_fetch_sub(refs, val) ((*(refs) -= (val)) + (val))
+#    endif  // __STDC_NO_ATOMICS__
+#endif      // YASLI_REFCOUNT
+
+// short strings come from per-thread slabs instead of malloc, which needs
+// atomics since a string may be freed by another thread
+#if !defined(YASLI_GC) && !defined(__STDC_NO_ATOMICS__)
+#    include <stdatomic.h>
+#    define STR_SMALL 1
 #endif  // YASLI_GC
 
+// the slabs and the pool of a thread are given back when it exits, where c11
+// threads exist
+#if (defined(STR_SMALL) || defined(YASLI_POOL)) && !defined(__STDC_NO_THREADS__)
+#    include <threads.h>
+#    define STR_THREAD_EXIT 1
+#endif  // STR_SMALL
+
+#ifndef YASLI_POOL_DEPTH
+// number of free blocks each size class keeps per thread
+#    define YASLI_POOL_DEPTH 64
+#endif  // YASLI_POOL_DEPTH
+
 // user should never change the value of length or capacity in the code.
 struct string_t {
     size_t length;
@@ -22,1782 +89,6524 @@ struct string_t {
     char cstr[1];
 };
 
-static inline bool str_resize(string_t **string, size_t size) {
-    size_t cap;
-    size_t capacity;
-    if (*string == NULL) {
-        *string = malloc(sizeof(string_t));
-        (*string)->capacity = 16;
-        capacity = 0;
+// size of the string header, the characters start right after it
+#define STR_HEADER offsetof(string_t, cstr)
+
+// every block handed out by this library is preceded by a tag, so str_free
+// knows where the memory came from. strings, arrays and wide strings all carry
+// one.
+typedef struct str_block_t {
+    uintptr_t owner;
+#ifdef YASLI_REFCOUNT
+    // number of owners of a shared string
+    str_refs_t refs;
+#endif  // YASLI_REFCOUNT
+} str_block_t;
+
+// the block is a malloc allocation of its own
+#define STR_OWNER_HEAP 0
+// the block lives inside a bigger allocation, like the tokens of
+// str_split_packed, and goes away together with it
+#define STR_OWNER_BORROWED 1
+// the block belongs to size class owner - STR_OWNER_POOL of the pool
+#define STR_OWNER_POOL 2
+// any owner from here on is a pointer, either the str_allocator_t the block
+// came from or, with the lowest bit set, the str_arena_t it was carved from,
+// or with the second bit set, the str_slab_t of a short string
+#define STR_OWNER_POINTER (STR_OWNER_POOL + STR_POOL_CLASSES)
+#define STR_OWNER_ARENA   1
+#define STR_OWNER_SLAB    2
+#define STR_OWNER_TAGS    3
+
+// powers of two up to 1024 and then steps of 512 up to 8192, the capacities
+// str_resize produces
+#define STR_POOL_CLASSES 21
+
+#define str_block(ptr) ((str_block_t *)(ptr) - 1)
+
+static inline void str_block_init(str_block_t *block, uintptr_t owner) {
+    block->owner = owner;
+#ifdef YASLI_REFCOUNT
+    atomic_init(&block->refs, 1);
+#endif  // YASLI_REFCOUNT
+}
+
+// blocks inside an arena or a shared allocation are aligned to this
+#define STR_ALIGN sizeof(size_t)
+
+#define STR_ARENA_CHUNK 65536
+
+// allocator every thread without an allocator of its own uses, NULL for malloc
+static const str_allocator_t *str_allocator = NULL;
+// allocator of the current thread, NULL to fall back to str_allocator
+static YASLI_TLS const str_allocator_t *str_thread_allocator = NULL;
+
+void str_set_allocator(const str_allocator_t *allocator) {
+    str_allocator = allocator;
+}
+
+void str_set_thread_allocator(const str_allocator_t *allocator) {
+    str_thread_allocator = allocator;
+}
+
+const str_allocator_t *str_get_allocator(void) {
+    return str_thread_allocator != NULL ? str_thread_allocator : str_allocator;
+}
+
+// untagged memory for the library's own bookkeeping, NULL allocator for malloc
+static inline void *str_raw_alloc(const str_allocator_t *allocator, size_t size) {
+    return allocator != NULL ? (allocator->alloc)(allocator->ctx, size) : malloc(size);
+}
+
+static inline void str_raw_free(const str_allocator_t *allocator, void *ptr) {
+    if (allocator != NULL) {
+        (allocator->free)(allocator->ctx, ptr);
     } else {
-        capacity = (*string)->capacity;
+        free(ptr);
     }
-    (*string)->length = size;
-    if (size < 16)
-        cap = 16;
-    else
-        cap = size + 1;
-    if (cap > (*string)->capacity) {
-        while ((*string)->capacity < cap) {
-            if ((*string)->capacity <= 1024) {
-                (*string)->capacity *= 2;
+}
+
+typedef struct str_chunk_t {
+    struct str_chunk_t *next;
+    size_t size;
+    char data[];
+} str_chunk_t;
+
+struct str_arena_t {
+    str_chunk_t *chunks;
+    char *cursor;
+    char *end;
+    // the block that ended at cursor, it can grow in place
+    void *last;
+    size_t chunk_size;
+    // allocator the arena and its chunks come from
+    const str_allocator_t *allocator;
+    // the arena holds the canonical strings of a str_intern_t
+    bool intern;
+};
+
+// arena the current thread allocates from, NULL for the heap
+static YASLI_TLS str_arena_t *str_arena = NULL;
+
+static void *str_arena_alloc(str_arena_t *arena, size_t size) {
+    size = (sizeof(str_block_t) + size + STR_ALIGN - 1) / STR_ALIGN * STR_ALIGN;
+    if ((size_t)(arena->end - arena->cursor) < size) {
+        if (size > arena->chunk_size / 4) {
+            // big blocks get a chunk of their own, so the current chunk keeps its space
+            str_chunk_t *chunk = str_raw_alloc(arena->allocator, sizeof(str_chunk_t) + size);
+            if (chunk == NULL) {
+                return NULL;
+            }
+            chunk->size = size;
+            if (arena->chunks == NULL) {
+                chunk->next = NULL;
+                arena->chunks = chunk;
             } else {
-                (*string)->capacity += 512;
+                chunk->next = arena->chunks->next;
+                arena->chunks->next = chunk;
             }
+            str_block_t *block = (str_block_t *)chunk->data;
+            str_block_init(block, (uintptr_t)arena | STR_OWNER_ARENA);
+            return block + 1;
         }
-        if ((*string)->capacity == capacity) return true;
-        (*string) = realloc((*string), sizeof(string_t) + sizeof(char) * ((*string)->capacity - 1));
-        if ((*string) == NULL) {
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: out of memory\n", stderr), false);
-#else
-            return false;
-#endif
+        str_chunk_t *chunk = str_raw_alloc(arena->allocator, sizeof(str_chunk_t) + arena->chunk_size);
+        if (chunk == NULL) {
+            return NULL;
         }
+        chunk->size = arena->chunk_size;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->cursor = chunk->data;
+        arena->end = chunk->data + chunk->size;
+    }
+    str_block_t *block = (str_block_t *)arena->cursor;
+    arena->cursor += size;
+    str_block_init(block, (uintptr_t)arena | STR_OWNER_ARENA);
+    arena->last = block + 1;
+    return block + 1;
+}
 
-    } else {
-        while (cap > 1024) {
-            if (cap + 512 < (*string)->capacity) {
-                (*string)->capacity -= 512;
-            } else
-                break;
+#ifdef STR_THREAD_EXIT
+static void str_thread_exit(void *unused);
+
+static once_flag str_exit_once = ONCE_FLAG_INIT;
+static tss_t str_exit_key;
+// without a key the caches of a thread stay until str_pool_trim
+static bool str_exit_ready = false;
+// whether str_thread_exit runs when the current thread exits
+static YASLI_TLS bool str_exit_registered = false;
+
+static void str_exit_init(void) {
+    str_exit_ready = tss_create(&str_exit_key, str_thread_exit) == thrd_success;
+}
+
+// make the current thread give its caches back when it exits, cheap to call
+// again
+static inline void str_exit_register(void) {
+    if (!str_exit_registered) {
+        call_once(&str_exit_once, str_exit_init);
+        str_exit_registered = true;
+        if (str_exit_ready) {
+            tss_set(str_exit_key, &str_exit_registered);
         }
-        while (cap <= 1024) {
-            if (cap * 2 <= (*string)->capacity) {
-                (*string)->capacity /= 2;
-            } else
-                break;
+    }
+}
+#endif  // STR_THREAD_EXIT
+
+#ifdef STR_SMALL
+// blocks of up to this size, the header and 32 characters, are carved out of
+// slabs of the allocating thread. with the default growth policy that is any
+// string shorter than 32 bytes
+#    define STR_SMALL_SIZE (STR_HEADER + 32)
+#    define STR_SMALL_SLOT (sizeof(str_block_t) + STR_SMALL_SIZE)
+#    define STR_SLAB_SIZE  4096
+// slabs a thread keeps for itself, an empty one is used again instead of
+// asking malloc for a new one
+#    define STR_SLABS 16
+// live starts this high while the slab belongs to a thread, so frees from
+// other threads can never bring it to zero before that
+#    define STR_SLAB_HOLD (SIZE_MAX / 2)
+// thread of a slab that no thread keeps any more
+#    define STR_SLAB_ORPHAN SIZE_MAX
+
+typedef struct str_slab_t {
+    // STR_SLAB_HOLD less the blocks freed by other threads while the slab
+    // belongs to a thread, the blocks left after that. the slab is freed when
+    // it drops to zero
+    atomic_size_t live;
+    // id of the thread the slab belongs to
+    atomic_size_t thread;
+    // blocks handed out and not freed by the thread the slab belongs to
+    size_t count;
+} str_slab_t;
+
+// ids of threads that allocated short strings, 0 for none yet
+static atomic_size_t str_thread_ids = 0;
+static YASLI_TLS size_t str_thread_id = 0;
+// slabs of the current thread, the one blocks are carved from and the cursor
+// and end of its free space
+static YASLI_TLS str_slab_t *str_slabs[STR_SLABS];
+static YASLI_TLS size_t str_slab_total = 0;
+static YASLI_TLS str_slab_t *str_slab = NULL;
+static YASLI_TLS char *str_slab_cursor = NULL;
+static YASLI_TLS char *str_slab_end = NULL;
+
+// give slab up, it goes away with its last block
+static void str_slab_orphan(str_slab_t *slab) {
+    atomic_store_explicit(&slab->thread, STR_SLAB_ORPHAN, memory_order_relaxed);
+    size_t hold = STR_SLAB_HOLD - slab->count;
+    if (atomic_fetch_sub(&slab->live, hold) == hold) {
+        free(slab);
+    }
+}
+
+static void str_slab_release(void) {
+    for (size_t i = 0; i < str_slab_total; i++) {
+        str_slab_orphan(str_slabs[i]);
+    }
+    str_slab_total = 0;
+    str_slab = NULL;
+    str_slab_cursor = NULL;
+    str_slab_end = NULL;
+}
+
+static bool str_slab_refill(void) {
+    str_slab_t *slab = NULL;
+    for (size_t i = 0; i < str_slab_total && slab == NULL; i++) {
+        // a slab whose blocks are all freed by now, none can be freed meanwhile
+        if (str_slabs[i]->count == STR_SLAB_HOLD - atomic_load(&str_slabs[i]->live)) {
+            slab = str_slabs[i];
+            atomic_store(&slab->live, STR_SLAB_HOLD);
+            slab->count = 0;
         }
-        if ((*string)->capacity == capacity) return true;
-        *string = realloc(*string, sizeof(string_t) + sizeof(char) * ((*string)->capacity - 1));
-        if ((*string) == NULL) {
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: out of memory\n", stderr), false);
-#else
+    }
+    if (slab == NULL) {
+        slab = malloc(STR_SLAB_SIZE);
+        if (slab == NULL) {
             return false;
-#endif
         }
+        if (str_thread_id == 0) {
+            str_thread_id = atomic_fetch_add(&str_thread_ids, 1) + 1;
+#    ifdef STR_THREAD_EXIT
+            str_exit_register();
+#    endif  // STR_THREAD_EXIT
+        }
+        atomic_init(&slab->live, STR_SLAB_HOLD);
+        atomic_init(&slab->thread, str_thread_id);
+        slab->count = 0;
+        if (str_slab_total == STR_SLABS) {
+            // the full slab that was filled first makes room
+            str_slab_orphan(str_slabs[0]);
+            memmove(str_slabs, str_slabs + 1, sizeof(str_slab_t *) * (STR_SLABS - 1));
+            str_slab_total--;
+        }
+        str_slabs[str_slab_total++] = slab;
     }
-    (*string)->cstr[(*string)->length] = 0;
+    str_slab = slab;
+    str_slab_cursor = (char *)(slab + 1);
+    str_slab_end = str_slab_cursor + (STR_SLAB_SIZE - sizeof(str_slab_t)) / STR_SMALL_SLOT * STR_SMALL_SLOT;
     return true;
 }
 
-string_t *str_new_string(const char *src) {
-    string_t *string = NULL;
-    if (str_resize(&string, strlen(src))) {
-        memmove(string->cstr, src, string->length);
-        string->cstr[string->length] = 0;
-        return string;
+static inline void *str_slab_alloc(void) {
+    if (str_slab_cursor == str_slab_end && !str_slab_refill()) {
+        return NULL;
     }
-    return NULL;
+    str_block_t *block = (str_block_t *)str_slab_cursor;
+    str_slab_cursor += STR_SMALL_SLOT;
+    str_slab->count++;
+    str_block_init(block, (uintptr_t)str_slab | STR_OWNER_SLAB);
+    return block + 1;
 }
 
-string_t *str_new_format(const char *format, ...) {
-    va_list ap, _ap;
-    va_start(ap, format);
-    va_copy(_ap, ap);
-    size_t size = vsnprintf(NULL, 0, format, ap);
-    va_end(ap);
-    string_t *string = NULL;
-    if (str_resize(&string, size)) {
-        vsnprintf(string->cstr, string->capacity, format, _ap);
-        va_end(_ap);
-        return string;
+static inline void str_slab_free(str_block_t *block) {
+    str_slab_t *slab = (str_slab_t *)(block->owner & ~(uintptr_t)STR_OWNER_TAGS);
+    if (atomic_load_explicit(&slab->thread, memory_order_relaxed) == str_thread_id) {
+        // a slab of this thread counts the blocks it frees without atomics, and
+        // the block handed out last, usually a temporary, is handed out again
+        slab->count--;
+        if (slab == str_slab && (char *)block + STR_SMALL_SLOT == str_slab_cursor) {
+            str_slab_cursor = (char *)block;
+        }
+    } else if (atomic_fetch_sub(&slab->live, 1) == 1) {
+        free(slab);
     }
-    return NULL;
 }
+#endif  // STR_SMALL
 
-string_t *str_new_strings(const char *src, ...) {
-    va_list ap, _ap;
-    va_start(ap, src);
-    va_copy(_ap, ap);
-    size_t length = 0;
-    for (const char *str = src; str != NULL; str = va_arg(ap, char *)) {
-        length += strlen(str);
+#ifdef YASLI_POOL
+typedef struct str_pool_t {
+    str_block_t *head;
+    size_t count;
+} str_pool_t;
+
+// free blocks of the current thread, the first word after the tag links them
+static YASLI_TLS str_pool_t str_pool[STR_POOL_CLASSES];
+
+static inline size_t str_pool_capacity(size_t index) {
+    return index <= 6 ? (size_t)16 << index : 1024 + (index - 6) * 512;
+}
+
+// size class that fits size bytes, STR_POOL_CLASSES if none does
+static inline size_t str_pool_class(size_t size) {
+    size_t cap = size > STR_HEADER ? size - STR_HEADER : 0;
+    if (cap > 8192) {
+        return STR_POOL_CLASSES;
+    }
+    if (cap > 1024) {
+        return 6 + (cap - 1024 + 511) / 512;
     }
-    va_end(ap);
     size_t index = 0;
-    string_t *result = NULL;
-    if (str_resize(&result, length)) {
-        for (const char *str = src; str != NULL; str = va_arg(_ap, char *)) {
-            strcpy(result->cstr + index, str);
-            index += strlen(str);
-        }
-        va_end(_ap);
-        return result;
+    while (((size_t)16 << index) < cap) {
+        index++;
     }
-    va_end(_ap);
-    return NULL;
+    return index;
 }
 
-string_t *str_new_string_arr(const char **src) {
-    size_t length = 0;
-    for (size_t i = 0; src[i] != NULL; i++) {
-        length += strlen(src[i]);
-    }
-    size_t index = 0;
-    string_t *result = NULL;
-    if (str_resize(&result, length)) {
-        for (size_t i = 0; src[i] != NULL; i++) {
-            strcpy(result->cstr + index, src[i]);
-            index += strlen(src[i]);
+static inline void *str_pool_alloc(size_t index) {
+    str_block_t *block = str_pool[index].head;
+    if (block != NULL) {
+        str_pool[index].head = *(str_block_t **)(block + 1);
+        str_pool[index].count--;
+    } else {
+        block = malloc(sizeof(str_block_t) + STR_HEADER + str_pool_capacity(index));
+        if (block == NULL) {
+            return NULL;
         }
-        return result;
     }
-    return NULL;
+    str_block_init(block, STR_OWNER_POOL + index);
+    return block + 1;
 }
 
-string_t *str_new_string_narr(const char **src, size_t size) {
-    size_t length = 0;
-    for (size_t i = 0; i < size; i++) {
-        length += strlen(src[i]);
+static inline void str_pool_free(str_block_t *block) {
+    size_t index = block->owner - STR_OWNER_POOL;
+    if (str_pool[index].count >= YASLI_POOL_DEPTH) {
+        free(block);
+        return;
     }
-    size_t index = 0;
-    string_t *result = NULL;
-    if (str_resize(&result, length)) {
-        for (size_t i = 0; src[i] != NULL; i++) {
-            strcpy(result->cstr + index, src[i]);
-            index += strlen(src[i]);
+#ifdef STR_THREAD_EXIT
+    str_exit_register();
+#endif  // STR_THREAD_EXIT
+    *(str_block_t **)(block + 1) = str_pool[index].head;
+    str_pool[index].head = block;
+    str_pool[index].count++;
+}
+#endif  // YASLI_POOL
+
+void str_pool_trim(void) {
+#ifdef STR_SMALL
+    str_slab_release();
+#endif  // STR_SMALL
+#ifdef YASLI_POOL
+    for (size_t i = 0; i < STR_POOL_CLASSES; i++) {
+        while (str_pool[i].head != NULL) {
+            str_block_t *block = str_pool[i].head;
+            str_pool[i].head = *(str_block_t **)(block + 1);
+            free(block);
         }
-        return result;
+        str_pool[i].count = 0;
     }
-    return NULL;
+#endif  // YASLI_POOL
 }
 
-void str_free(void *string) {
-    free(string);
+#ifdef STR_THREAD_EXIT
+static void str_thread_exit(void *unused) {
+    (void)unused;
+    str_pool_trim();
 }
+#endif  // STR_THREAD_EXIT
 
-void str_frees(string_t *string, ...) {
-    va_list ap;
-    va_start(ap, string);
-    for (string_t *str = string; str != NULL; str = va_arg(ap, string_t *)) {
-        free(str);
+static inline void *str_heap_alloc(size_t size) {
+    const str_allocator_t *allocator = str_get_allocator();
+    if (allocator != NULL) {
+        str_block_t *block = (allocator->alloc)(allocator->ctx, sizeof(str_block_t) + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        str_block_init(block, (uintptr_t)allocator);
+        return block + 1;
     }
-    va_end(ap);
+#ifdef STR_SMALL
+    if (size <= STR_SMALL_SIZE) {
+        return str_slab_alloc();
+    }
+#endif  // STR_SMALL
+#ifdef YASLI_POOL
+    size_t index = str_pool_class(size);
+    if (index < STR_POOL_CLASSES) {
+        return str_pool_alloc(index);
+    }
+#endif  // YASLI_POOL
+    str_block_t *block = malloc(sizeof(str_block_t) + size);
+    if (block == NULL) {
+        return NULL;
+    }
+    str_block_init(block, STR_OWNER_HEAP);
+    return block + 1;
 }
 
-void str_free_arr(string_t **str_arr) {
-    for (size_t i = 0; str_arr[i] != NULL; i++) {
-        free(str_arr[i]);
+static inline void *str_mem_alloc(size_t size) {
+    if (str_arena != NULL) {
+        return str_arena_alloc(str_arena, size);
     }
-    free(str_arr);
+    return str_heap_alloc(size);
 }
 
-size_t str_strlen(const string_t *string) {
-    return (size_t)string->length;
+// old_size is the size of the block that is resized
+static inline void *str_mem_realloc(void *ptr, size_t old_size, size_t size) {
+    str_block_t *block = str_block(ptr);
+    if (block->owner == STR_OWNER_HEAP) {
+        block = realloc(block, sizeof(str_block_t) + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        return block + 1;
+    }
+#ifdef YASLI_POOL
+    if (block->owner >= STR_OWNER_POOL && block->owner < STR_OWNER_POINTER) {
+        size_t index = block->owner - STR_OWNER_POOL;
+        if (size <= STR_HEADER + str_pool_capacity(index)) {
+            return ptr;
+        }
+        void *result = str_heap_alloc(size);
+        if (result != NULL) {
+            memcpy(result, ptr, old_size < size ? old_size : size);
+            str_pool_free(block);
+        }
+        return result;
+    }
+#endif  // YASLI_POOL
+#ifdef STR_SMALL
+    if (block->owner >= STR_OWNER_POINTER && (block->owner & STR_OWNER_TAGS) == STR_OWNER_SLAB) {
+        if (size <= STR_SMALL_SIZE) {
+            return ptr;
+        }
+        void *result = str_heap_alloc(size);
+        if (result != NULL) {
+            memcpy(result, ptr, old_size);
+            str_slab_free(block);
+        }
+        return result;
+    }
+#endif  // STR_SMALL
+    if (block->owner >= STR_OWNER_POINTER && (block->owner & STR_OWNER_TAGS) == 0) {
+        const str_allocator_t *allocator = (const str_allocator_t *)block->owner;
+        block = (allocator->realloc)(allocator->ctx, block, sizeof(str_block_t) + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        return block + 1;
+    }
+    if (block->owner >= STR_OWNER_POINTER && (block->owner & STR_OWNER_TAGS) == STR_OWNER_ARENA) {
+        str_arena_t *arena = (str_arena_t *)(block->owner & ~(uintptr_t)STR_OWNER_ARENA);
+        if (ptr == arena->last) {
+            size_t end = (sizeof(str_block_t) + size + STR_ALIGN - 1) / STR_ALIGN * STR_ALIGN;
+            if ((size_t)(arena->end - (char *)block) >= end) {
+                arena->cursor = (char *)block + end;
+                return ptr;
+            }
+        } else if (size <= old_size) {
+            return ptr;
+        }
+        void *result = str_arena_alloc(arena, size);
+        if (result != NULL) {
+            memcpy(result, ptr, old_size < size ? old_size : size);
+        }
+        return result;
+    }
+    void *result = str_mem_alloc(size);
+    if (result != NULL) {
+        memcpy(result, ptr, old_size < size ? old_size : size);
+    }
+    return result;
 }
 
-size_t str_utf8_strlen(const string_t *string) {
-    if (string == NULL) {
+static inline void str_mem_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    str_block_t *block = str_block(ptr);
+#ifdef YASLI_REFCOUNT
+    if (atomic_fetch_sub(&block->refs, 1) > 1) {
+        return;
+    }
+#endif  // YASLI_REFCOUNT
+    if (block->owner == STR_OWNER_HEAP) {
+        free(block);
+    }
+#ifdef YASLI_POOL
+    else if (block->owner >= STR_OWNER_POOL && block->owner < STR_OWNER_POINTER) {
+        str_pool_free(block);
+    }
+#endif  // YASLI_POOL
+#ifdef STR_SMALL
+    else if (block->owner >= STR_OWNER_POINTER && (block->owner & STR_OWNER_TAGS) == STR_OWNER_SLAB) {
+        str_slab_free(block);
+    }
+#endif  // STR_SMALL
+    else if (block->owner >= STR_OWNER_POINTER && (block->owner & STR_OWNER_TAGS) == 0) {
+        const str_allocator_t *allocator = (const str_allocator_t *)block->owner;
+        (allocator->free)(allocator->ctx, block);
+    }
+}
+
+str_arena_t *str_arena_new(size_t chunk_size) {
+    const str_allocator_t *allocator = str_get_allocator();
+    str_arena_t *arena = str_raw_alloc(allocator, sizeof(str_arena_t));
+    if (arena == NULL) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: input is NULL\n", stderr), 0);
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
 #else
-        return 0;
+        return NULL;
 #endif
     }
-    size_t current_char = 0;
-    size_t length = 0;
-    const unsigned char *ptr = (const unsigned char *)string->cstr;
+    arena->chunks = NULL;
+    arena->cursor = NULL;
+    arena->end = NULL;
+    arena->last = NULL;
+    arena->chunk_size = chunk_size == 0 ? STR_ARENA_CHUNK : chunk_size;
+    arena->allocator = allocator;
+    arena->intern = false;
+    return arena;
+}
 
-    while (length <= string->length) {
-        if (*ptr == 0) {
-            return current_char;
-        } else if ((*ptr & 0x80) == 0) {
-            ptr++;
-            length++;
-        } else if ((*ptr & 0xE0) == 0xC0) {
-            ptr += 2;
-            length += 2;
-        } else if ((*ptr & 0xF0) == 0xE0) {
-            ptr += 3;
-            length += 3;
-        } else if ((*ptr & 0xF8) == 0xF0) {
-            ptr += 4;
-            length += 4;
+void str_arena_reset(str_arena_t *arena) {
+    // keep one regular chunk around, the next round of strings most likely needs it
+    str_chunk_t *keep = NULL;
+    str_chunk_t *chunk = arena->chunks;
+    while (chunk != NULL) {
+        str_chunk_t *next = chunk->next;
+        if (keep == NULL && chunk->size == arena->chunk_size) {
+            keep = chunk;
         } else {
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), 0);
-#else
-            return 0;
-#endif
+            str_raw_free(arena->allocator, chunk);
         }
-        current_char++;
+        chunk = next;
+    }
+    arena->chunks = keep;
+    arena->last = NULL;
+    if (keep != NULL) {
+        keep->next = NULL;
+        arena->cursor = keep->data;
+        arena->end = keep->data + keep->size;
+    } else {
+        arena->cursor = NULL;
+        arena->end = NULL;
     }
-    return current_char;
 }
 
-size_t str_capacity(const string_t *string) {
-    return (size_t)string->capacity;
+void str_arena_free(str_arena_t *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    if (str_arena == arena) {
+        str_arena = NULL;
+    }
+    str_chunk_t *chunk = arena->chunks;
+    while (chunk != NULL) {
+        str_chunk_t *next = chunk->next;
+        str_raw_free(arena->allocator, chunk);
+        chunk = next;
+    }
+    str_raw_free(arena->allocator, arena);
 }
 
-const char *str_cstr(const string_t *string) {
-    return (const char *)string->cstr;
+#ifdef YASLI_REFCOUNT
+// whether string is owned by its block alone, borrowed storage and arena
+// blocks go away with their owner and can not be shared
+static inline bool str_shareable(const string_t *string) {
+    uintptr_t owner = str_block(string)->owner;
+    return owner != STR_OWNER_BORROWED && (owner < STR_OWNER_POINTER || (owner & STR_OWNER_TAGS) != STR_OWNER_ARENA);
 }
 
-const wchar_t *str_wstr(const string_t *string) {
-    wchar_t *res;
-    size_t size = mbstowcs(NULL, string->cstr, string->capacity);
-    if (size != (size_t)-1) {
-        res = malloc(sizeof(wchar_t) * (size + 1));
-        if (res != NULL) {
-            mbstowcs(res, string->cstr, string->capacity);
-            return (const wchar_t *)res;
-        }
-#ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: run out of memory\n", stderr), NULL);
-#else
-        return NULL;
-#endif
+// give string a block of its own before it is changed, the other owners keep
+// the old contents
+static bool str_unshare(string_t **string) {
+    if (atomic_load(&str_block(*string)->refs) <= 1) {
+        return true;
     }
-#ifdef YASLI_DEBUG
-    return (fputs("[ERRO]: invalid multibyte sequence\n", stderr), NULL);
-#else
-    return NULL;
-#endif
+    string_t *copy = str_mem_alloc(STR_HEADER + sizeof(char) * (*string)->capacity);
+    if (copy == NULL) {
+#    ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), false);
+#    else
+        return false;
+#    endif
+    }
+    memcpy(copy, *string, STR_HEADER + sizeof(char) * ((*string)->length + 1));
+    str_mem_free(*string);
+    *string = copy;
+    return true;
 }
 
-bool str_clear(string_t **string) {
-    if (str_resize(string, 0)) {
-        memset((*string)->cstr, 0, sizeof(char) * 16);
+// whether string is shared, functions that change a string_t* in place can
+// not copy it and leave it alone
+static inline bool str_is_shared(const string_t *string) {
+    if (atomic_load(&str_block(string)->refs) > 1) {
+#    ifdef YASLI_DEBUG
+        fputs("[ERRO]: shared string can not be changed in place\n", stderr);
+#    endif
         return true;
     }
     return false;
 }
+#endif  // YASLI_REFCOUNT
 
-string_t *str_clear_to(string_t *old, string_t *new) {
-    free(old);
-    return new;
+// whether string is the canonical string of an intern pool
+static inline bool str_is_interned(const string_t *string) {
+    uintptr_t owner = str_block(string)->owner;
+    if (owner < STR_OWNER_POINTER || (owner & STR_OWNER_TAGS) != STR_OWNER_ARENA) {
+        return false;
+    }
+    return ((str_arena_t *)(owner & ~(uintptr_t)STR_OWNER_ARENA))->intern;
 }
 
-bool str_reserve(string_t *string, size_t length) {
-    size_t size = string->length;
-    if (length <= size) {
-        return true;
+str_arena_t *str_arena_use(str_arena_t *arena) {
+    str_arena_t *prev = str_arena;
+    str_arena = arena;
+    return prev;
+}
+
+size_t str_grow_default(size_t capacity, size_t required) {
+    if (capacity < 16) {
+        capacity = 16;
+    }
+    // doubling stops above 1024, so this runs a few times at most
+    while (capacity < required && capacity <= 1024) {
+        capacity *= 2;
+    }
+    if (capacity < required) {
+        capacity += (required - capacity + 511) / 512 * 512;
+    }
+    return capacity;
+}
+
+size_t str_grow_2x(size_t capacity, size_t required) {
+    if (capacity < 16) {
+        capacity = 16;
+    }
+    if (capacity >= required) {
+        return capacity;
+    }
+    return capacity * 2 > required ? capacity * 2 : required;
+}
+
+size_t str_grow_1_5x(size_t capacity, size_t required) {
+    if (capacity < 16) {
+        capacity = 16;
+    }
+    if (capacity >= required) {
+        return capacity;
+    }
+    return capacity + capacity / 2 > required ? capacity + capacity / 2 : required;
+}
+
+size_t str_grow_page(size_t capacity, size_t required) {
+    if (required <= 4096) {
+        return str_grow_default(capacity, required);
+    }
+    if (capacity >= required) {
+        return capacity;
+    }
+    // grow by 1.5x and round the whole allocation up to a multiple of the page
+    size_t size = str_grow_1_5x(capacity, required) + sizeof(str_block_t) + STR_HEADER;
+    return (size + 4095) / 4096 * 4096 - sizeof(str_block_t) - STR_HEADER;
+}
+
+// growth policy of every string, NULL for str_grow_default
+static str_growth_t str_growth = NULL;
+
+void str_set_growth(str_growth_t growth) {
+    str_growth = growth;
+}
+
+// capacity needed to hold cap bytes, growing from capacity
+static inline size_t str_grow(size_t capacity, size_t cap) {
+    size_t result = str_growth != NULL ? str_growth(capacity, cap) : str_grow_default(capacity, cap);
+    return result < cap ? cap : result;
+}
+
+// whether strings give memory back on their own when they get shorter
+static bool str_shrinking = true;
+
+void str_set_shrink(bool shrink) {
+    str_shrinking = shrink;
+}
+
+// capacity left after shrinking from capacity to hold only cap bytes. a string
+// only shrinks once it uses a quarter of its capacity, so a buffer that is
+// reused for contents of similar size keeps its memory
+static inline size_t str_shrink(size_t capacity, size_t cap) {
+    if (!str_shrinking || cap > capacity / 4) {
+        return capacity;
+    }
+    return str_grow(16, cap);
+}
+
+static inline bool str_resize(string_t **string, size_t size) {
+    size_t cap;
+    size_t capacity;
+    if (size < 16)
+        cap = 16;
+    else
+        cap = size + 1;
+    string_t *result;
+    if (*string == NULL) {
+        // a new string is allocated once with its final capacity
+        capacity = str_grow(16, cap);
+        result = str_mem_alloc(STR_HEADER + sizeof(char) * capacity);
     } else {
-        bool res = str_resize(&string, length);
-        string->length = size;
-        return res;
+#ifdef YASLI_REFCOUNT
+        if (!str_unshare(string)) {
+            return false;
+        }
+#endif  // YASLI_REFCOUNT
+        if (str_block(*string)->owner == STR_OWNER_BORROWED && size < (*string)->capacity) {
+            // borrowed storage never shrinks, and only moves out once it is too small
+            (*string)->length = size;
+            (*string)->cstr[size] = 0;
+            return true;
+        }
+        capacity = (*string)->capacity;
+        if (cap > capacity) {
+            capacity = str_grow(capacity, cap);
+        } else {
+            capacity = str_shrink(capacity, cap);
+        }
+        if (capacity == (*string)->capacity) {
+            (*string)->length = size;
+            (*string)->cstr[size] = 0;
+            return true;
+        }
+        result = str_mem_realloc(*string, STR_HEADER + sizeof(char) * (*string)->capacity, STR_HEADER + sizeof(char) * capacity);
+    }
+    if (result == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), false);
+#else
+        return false;
+#endif
     }
+    *string = result;
+    (*string)->capacity = capacity;
+    (*string)->length = size;
+    (*string)->cstr[size] = 0;
+    return true;
 }
 
-string_t *str_appended(const string_t *start, const string_t *end) {
-    size_t length = start->length + end->length;
-    string_t *result = NULL;
-    if (str_resize(&result, length)) {
-        strcpy(result->cstr, start->cstr);
-        strcpy(result->cstr + start->length, end->cstr);
-        return result;
+// scalar search, also used for what is left after the vector loop
+static inline const char *str_memmem_scalar(const char *haystack, size_t hlen, const char *needle, size_t nlen) {
+    const char *end = haystack + (hlen - nlen + 1);
+    for (const char *ptr = haystack; (ptr = memchr(ptr, needle[0], end - ptr)) != NULL; ptr++) {
+        if (ptr[nlen - 1] == needle[nlen - 1] && memcmp(ptr + 1, needle + 1, nlen - 1) == 0) {
+            return ptr;
+        }
     }
     return NULL;
 }
 
-string_t *str_append(string_t **start, const string_t *end) {
-    size_t length = (*start)->length;
-    if (str_resize(start, (*start)->length + end->length)) {
-        strcpy((*start)->cstr + length, end->cstr);
-        return *start;
+// first occurrence of needle in haystack, NULL if there is none. unlike
+// strstr it is bounded by the lengths and goes past null bytes. the vector
+// loop compares a block of candidate positions against the first and the last
+// byte of needle at once, and only checks the rest with memcmp where both match
+static const char *str_memmem(const char *haystack, size_t hlen, const char *needle, size_t nlen) {
+    if (nlen == 0) {
+        return haystack;
     }
-    return NULL;
+    if (nlen > hlen) {
+        return NULL;
+    }
+    if (nlen == 1) {
+        return memchr(haystack, needle[0], hlen);
+    }
+    size_t i = 0;
+#if defined(STR_AVX2)
+    while (i + nlen - 1 + 32 <= hlen) {
+        // set up again after every memcmp, so the constants are not spilled
+        // across the call for the whole loop
+        const __m256i first = _mm256_set1_epi8(needle[0]);
+        const __m256i last = _mm256_set1_epi8(needle[nlen - 1]);
+        uint32_t mask = 0;
+        for (; i + nlen - 1 + 32 <= hlen; i += 32) {
+            __m256i head = _mm256_loadu_si256((const __m256i *)(haystack + i));
+            __m256i tail = _mm256_loadu_si256((const __m256i *)(haystack + i + nlen - 1));
+            mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+            if (mask != 0) {
+                break;
+            }
+        }
+        if (mask == 0) {
+            break;
+        }
+        for (; mask != 0; mask &= mask - 1) {
+            size_t bit = str_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, nlen - 2) == 0) {
+                return haystack + i + bit;
+            }
+        }
+        i += 32;
+    }
+#elif defined(STR_SSE2)
+    while (i + nlen - 1 + 16 <= hlen) {
+        // set up again after every memcmp, so the constants are not spilled
+        // across the call for the whole loop
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[nlen - 1]);
+        uint32_t mask = 0;
+        for (; i + nlen - 1 + 16 <= hlen; i += 16) {
+            __m128i head = _mm_loadu_si128((const __m128i *)(haystack + i));
+            __m128i tail = _mm_loadu_si128((const __m128i *)(haystack + i + nlen - 1));
+            mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+            if (mask != 0) {
+                break;
+            }
+        }
+        if (mask == 0) {
+            break;
+        }
+        for (; mask != 0; mask &= mask - 1) {
+            size_t bit = str_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, nlen - 2) == 0) {
+                return haystack + i + bit;
+            }
+        }
+        i += 16;
+    }
+#endif  // STR_AVX2
+    return str_memmem_scalar(haystack + i, hlen - i, needle, nlen);
 }
 
-string_t *str_appendeds(const string_t *start, ...) {
-    va_list ap, _ap;
-    va_start(ap, start);
-    va_copy(_ap, ap);
-    size_t length = 0;
-    for (const string_t *str = start; str != NULL; str = va_arg(ap, string_t *)) {
-        length += str->length;
+// last occurrence of needle in haystack, NULL if there is none. the same
+// filter as str_memmem, running from the end towards the start
+static const char *str_memrmem(const char *haystack, size_t hlen, const char *needle, size_t nlen) {
+    if (nlen == 0) {
+        return haystack + hlen;
     }
-    va_end(ap);
-    string_t *result = NULL;
-    if (str_resize(&result, length)) {
-        size_t index = 0;
-        for (const string_t *str = start; str != NULL; str = va_arg(_ap, string_t *)) {
-            strcpy(result->cstr + index, str->cstr);
-            index += str->length;
+    if (nlen > hlen) {
+        return NULL;
+    }
+    // candidates are the indices up to hlen - nlen, count of them are left
+    size_t count = hlen - nlen + 1;
+#if defined(STR_AVX2)
+    while (count >= 32) {
+        // set up again after every memcmp, so the constants are not spilled
+        // across the call for the whole loop
+        const __m256i first = _mm256_set1_epi8(needle[0]);
+        const __m256i last = _mm256_set1_epi8(needle[nlen - 1]);
+        uint32_t mask = 0;
+        for (; count >= 32; count -= 32) {
+            __m256i head = _mm256_loadu_si256((const __m256i *)(haystack + count - 32));
+            __m256i tail = _mm256_loadu_si256((const __m256i *)(haystack + count - 32 + nlen - 1));
+            mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+            if (mask != 0) {
+                break;
+            }
+        }
+        if (mask == 0) {
+            break;
+        }
+        for (; mask != 0; mask &= ~(UINT32_C(0x80000000) >> str_clz(mask))) {
+            const char *ptr = haystack + count - 32 + (31 - str_clz(mask));
+            if (memcmp(ptr, needle, nlen) == 0) {
+                return ptr;
+            }
+        }
+        count -= 32;
+    }
+#elif defined(STR_SSE2)
+    while (count >= 16) {
+        // set up again after every memcmp, so the constants are not spilled
+        // across the call for the whole loop
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[nlen - 1]);
+        uint32_t mask = 0;
+        for (; count >= 16; count -= 16) {
+            __m128i head = _mm_loadu_si128((const __m128i *)(haystack + count - 16));
+            __m128i tail = _mm_loadu_si128((const __m128i *)(haystack + count - 16 + nlen - 1));
+            mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+            if (mask != 0) {
+                break;
+            }
+        }
+        if (mask == 0) {
+            break;
+        }
+        for (; mask != 0; mask &= ~(UINT32_C(0x80000000) >> str_clz(mask))) {
+            const char *ptr = haystack + count - 16 + (31 - str_clz(mask));
+            if (memcmp(ptr, needle, nlen) == 0) {
+                return ptr;
+            }
+        }
+        count -= 16;
+    }
+#endif  // STR_AVX2
+    while (count > 0) {
+        const char *ptr = haystack + --count;
+        if (ptr[0] == needle[0] && ptr[nlen - 1] == needle[nlen - 1] && memcmp(ptr, needle, nlen) == 0) {
+            return ptr;
         }
-        va_end(_ap);
-        return result;
     }
-    va_end(_ap);
     return NULL;
 }
 
-string_t *str_appends(string_t **start, ...) {
-    va_list ap, _ap;
-    va_start(ap, start);
-    va_copy(_ap, ap);
-    size_t length = 0;
-    for (const string_t *str = *start; str != NULL; str = va_arg(ap, string_t *)) {
-        length += str->length;
+// ascii case folding, unlike tolower it does not look at the locale
+static inline unsigned char str_fold(unsigned char ch) {
+    return (unsigned)(ch - 'A') < 26 ? ch | 0x20 : ch;
+}
+
+#if defined(STR_AVX2)
+static inline __m256i str_fold_avx2(__m256i bytes) {
+    // only A to Z end up below -102 once 0x3f is added
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(-102), _mm256_add_epi8(bytes, _mm256_set1_epi8(0x3f)));
+    return _mm256_or_si256(bytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+#endif  // STR_AVX2
+
+#if defined(STR_SSE2)
+static inline __m128i str_fold_sse2(__m128i bytes) {
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(-102), _mm_add_epi8(bytes, _mm_set1_epi8(0x3f)));
+    return _mm_or_si128(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif  // STR_SSE2
+
+// compare n bytes ignoring ascii case
+static bool str_memieq(const char *str1, const char *str2, size_t n) {
+    size_t i = 0;
+#if defined(STR_AVX2)
+    for (; i + 32 <= n; i += 32) {
+        __m256i bytes1 = str_fold_avx2(_mm256_loadu_si256((const __m256i *)(str1 + i)));
+        __m256i bytes2 = str_fold_avx2(_mm256_loadu_si256((const __m256i *)(str2 + i)));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes1, bytes2)) != UINT32_MAX) {
+            return false;
+        }
     }
-    va_end(ap);
-    size_t index = (*start)->length;
-    if (str_resize(start, length)) {
-        for (const string_t *str = va_arg(_ap, string_t *); str != NULL; str = va_arg(_ap, string_t *)) {
-            strcpy((*start)->cstr + index, str->cstr);
-            index += str->length;
+#endif  // STR_AVX2
+#if defined(STR_SSE2)
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes1 = str_fold_sse2(_mm_loadu_si128((const __m128i *)(str1 + i)));
+        __m128i bytes2 = str_fold_sse2(_mm_loadu_si128((const __m128i *)(str2 + i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(bytes1, bytes2)) != 0xffff) {
+            return false;
         }
-        va_end(_ap);
-        return *start;
     }
-    va_end(_ap);
-    return NULL;
+#endif  // STR_SSE2
+    for (; i < n; i++) {
+        if (str_fold(str1[i]) != str_fold(str2[i])) {
+            return false;
+        }
+    }
+    return true;
 }
 
-string_t *str_appended_cstr(const string_t *start, const char *end) {
-    size_t start_len = start->length;
-    size_t end_len = strlen(end);
-    string_t *result = NULL;
-    if (str_resize(&result, start_len + end_len)) {
-        strcpy(result->cstr, start->cstr);
-        strcpy(result->cstr + start_len, end);
-        result->cstr[result->length] = 0;
-        return result;
+// str_memmem ignoring ascii case, the first and last bytes are folded before
+// they are compared
+static const char *str_memimem(const char *haystack, size_t hlen, const char *needle, size_t nlen) {
+    if (nlen == 0) {
+        return haystack;
+    }
+    if (nlen > hlen) {
+        return NULL;
+    }
+    unsigned char first = str_fold(needle[0]);
+    unsigned char last = str_fold(needle[nlen - 1]);
+    size_t i = 0;
+#if defined(STR_AVX2)
+    while (i + nlen - 1 + 32 <= hlen) {
+        const __m256i firsts = _mm256_set1_epi8((char)first);
+        const __m256i lasts = _mm256_set1_epi8((char)last);
+        uint32_t mask = 0;
+        for (; i + nlen - 1 + 32 <= hlen; i += 32) {
+            __m256i head = str_fold_avx2(_mm256_loadu_si256((const __m256i *)(haystack + i)));
+            __m256i tail = str_fold_avx2(_mm256_loadu_si256((const __m256i *)(haystack + i + nlen - 1)));
+            mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, firsts), _mm256_cmpeq_epi8(tail, lasts)));
+            if (mask != 0) {
+                break;
+            }
+        }
+        if (mask == 0) {
+            break;
+        }
+        for (; mask != 0; mask &= mask - 1) {
+            size_t bit = str_ctz(mask);
+            if (str_memieq(haystack + i + bit, needle, nlen)) {
+                return haystack + i + bit;
+            }
+        }
+        i += 32;
+    }
+#elif defined(STR_SSE2)
+    while (i + nlen - 1 + 16 <= hlen) {
+        const __m128i firsts = _mm_set1_epi8((char)first);
+        const __m128i lasts = _mm_set1_epi8((char)last);
+        uint32_t mask = 0;
+        for (; i + nlen - 1 + 16 <= hlen; i += 16) {
+            __m128i head = str_fold_sse2(_mm_loadu_si128((const __m128i *)(haystack + i)));
+            __m128i tail = str_fold_sse2(_mm_loadu_si128((const __m128i *)(haystack + i + nlen - 1)));
+            mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, firsts), _mm_cmpeq_epi8(tail, lasts)));
+            if (mask != 0) {
+                break;
+            }
+        }
+        if (mask == 0) {
+            break;
+        }
+        for (; mask != 0; mask &= mask - 1) {
+            size_t bit = str_ctz(mask);
+            if (str_memieq(haystack + i + bit, needle, nlen)) {
+                return haystack + i + bit;
+            }
+        }
+        i += 16;
+    }
+#endif  // STR_AVX2
+    for (; i + nlen <= hlen; i++) {
+        if (str_fold(haystack[i]) == first && str_fold(haystack[i + nlen - 1]) == last && str_memieq(haystack + i, needle, nlen)) {
+            return haystack + i;
+        }
     }
     return NULL;
 }
 
-string_t *str_append_cstr(string_t **start, const char *end) {
-    size_t start_len = (*start)->length;
-    size_t end_len = strlen(end);
-    if (str_resize(start, (*start)->length + end_len)) {
-        strcpy((*start)->cstr + start_len, end);
-        return *start;
+string_t *str_new_string(const char *src) {
+    string_t *string = NULL;
+    if (str_resize(&string, strlen(src))) {
+        memmove(string->cstr, src, string->length);
+        string->cstr[string->length] = 0;
+        return string;
     }
     return NULL;
 }
 
-string_t *str_appended_cstrs(const string_t *start, ...) {
+string_t *str_new_format(const char *format, ...) {
     va_list ap, _ap;
-    va_start(ap, start);
+    va_start(ap, format);
     va_copy(_ap, ap);
-    size_t length = 0;
-    for (const char *string = start->cstr; string != NULL; string = va_arg(ap, char *)) {
-        length += strlen(string);
-    }
+    size_t size = vsnprintf(NULL, 0, format, ap);
     va_end(ap);
-    string_t *result = NULL;
-    if (str_resize(&result, length)) {
-        size_t index = 0;
-        for (const char *string = start->cstr; string != NULL; string = va_arg(_ap, char *)) {
-            strcpy(result->cstr + index, string);
-            index += strlen(string);
-        }
+    string_t *string = NULL;
+    if (str_resize(&string, size)) {
+        vsnprintf(string->cstr, string->capacity, format, _ap);
         va_end(_ap);
-        return result;
+        return string;
     }
-    va_end(_ap);
     return NULL;
 }
 
-string_t *str_append_cstrs(string_t **start, ...) {
+string_t *str_new_strings(const char *src, ...) {
     va_list ap, _ap;
-    va_start(ap, start);
+    va_start(ap, src);
     va_copy(_ap, ap);
     size_t length = 0;
-    for (const char *string = (*start)->cstr; string != NULL; string = va_arg(ap, char *)) {
-        length += strlen(string);
+    for (const char *str = src; str != NULL; str = va_arg(ap, char *)) {
+        length += strlen(str);
     }
     va_end(ap);
-    size_t index = (*start)->length;
-    if (str_resize(start, length)) {
-        for (const char *string = va_arg(_ap, char *); string != NULL; string = va_arg(_ap, char *)) {
-            strcpy((*start)->cstr + index, string);
-            index += strlen(string);
+    size_t index = 0;
+    string_t *result = NULL;
+    if (str_resize(&result, length)) {
+        for (const char *str = src; str != NULL; str = va_arg(_ap, char *)) {
+            strcpy(result->cstr + index, str);
+            index += strlen(str);
         }
         va_end(_ap);
-        return *start;
+        return result;
     }
     va_end(_ap);
     return NULL;
 }
 
-string_t **str_split(const string_t *src, const char *needle) {
-    size_t nlen = strlen(needle);
-    char *str = malloc(sizeof(char) * (src->length + 1));
-    strncpy(str, src->cstr, src->length + 1);
-    char *ptr = str;
-    size_t cap = 16;
-    string_t **tokens = malloc(sizeof(string_t *) * cap);
-    char *token;
+string_t *str_new_string_arr(const char **src) {
+    size_t length = 0;
+    for (size_t i = 0; src[i] != NULL; i++) {
+        length += strlen(src[i]);
+    }
     size_t index = 0;
+    string_t *result = NULL;
+    if (str_resize(&result, length)) {
+        for (size_t i = 0; src[i] != NULL; i++) {
+            strcpy(result->cstr + index, src[i]);
+            index += strlen(src[i]);
+        }
+        return result;
+    }
+    return NULL;
+}
 
-    token = strstr(str, needle);
-    while (token != NULL) {
-        *token = 0;
-        tokens[index] = NULL;
-        if (!str_resize(&tokens[index], strlen(str))) return (free(ptr), NULL);
-        strcpy(tokens[index]->cstr, str);
-        str = token + nlen;
-        index++;
-        token = strstr(str, needle);
-        if (index + 2 == cap) {
-            cap += 16;
-            tokens = realloc(tokens, sizeof(string_t *) * cap);
-        }
-    }
-    tokens[index] = NULL;
-    if (!str_resize(&tokens[index], strlen(str))) return (free(ptr), NULL);
-    strcpy(tokens[index]->cstr, str);
-    index++;
-    tokens[index] = NULL;
-    free(ptr);
-    return tokens;
+string_t *str_new_string_narr(const char **src, size_t size) {
+    size_t length = 0;
+    for (size_t i = 0; i < size; i++) {
+        length += strlen(src[i]);
+    }
+    size_t index = 0;
+    string_t *result = NULL;
+    if (str_resize(&result, length)) {
+        for (size_t i = 0; src[i] != NULL; i++) {
+            strcpy(result->cstr + index, src[i]);
+            index += strlen(src[i]);
+        }
+        return result;
+    }
+    return NULL;
 }
 
-void str_to_upper(string_t *string) {
-    for (size_t i = 0; i < string->length; i++) {
-        string->cstr[i] = toupper(string->cstr[i]);
+// whether string is a token of str_split_packed, which only goes away with
+// its array
+static inline bool str_is_borrowed(const void *string) {
+    if (string != NULL && str_block(string)->owner == STR_OWNER_BORROWED) {
+#ifdef YASLI_DEBUG
+        fputs("[ERRO]: token of str_split_packed is freed with its array only\n", stderr);
+#endif
+        return true;
     }
+    return false;
 }
 
-void str_to_lower(string_t *string) {
-    for (size_t i = 0; i < string->length; i++) {
-        string->cstr[i] = tolower(string->cstr[i]);
+void str_free(void *string) {
+    if (!str_is_borrowed(string)) {
+        str_mem_free(string);
     }
 }
 
-string_t *str_substr(const string_t *src, size_t start, size_t size) {
-    if (start + size > src->length) {
-#ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bound\n", stderr), NULL);
-#else
-        return NULL;
-#endif
+void str_frees(string_t *string, ...) {
+    va_list ap;
+    va_start(ap, string);
+    for (string_t *str = string; str != NULL; str = va_arg(ap, string_t *)) {
+        if (!str_is_borrowed(str)) {
+            str_mem_free(str);
+        }
     }
-    string_t *substr = NULL;
-    if (str_resize(&substr, size)) {
-        strncpy(substr->cstr, src->cstr + start, size);
-        substr->cstr[substr->length] = 0;
-        return substr;
+    va_end(ap);
+}
+
+void str_free_arr(string_t **str_arr) {
+    for (size_t i = 0; str_arr[i] != NULL; i++) {
+        str_mem_free(str_arr[i]);
     }
-    return NULL;
+    str_mem_free(str_arr);
 }
 
-string_t *str_utf8_substr(const string_t *src, size_t start, size_t size) {
-    if (start + size > src->length) {
+size_t str_strlen(const string_t *string) {
+    return (size_t)string->length;
+}
+
+size_t str_utf8_strlen(const string_t *string) {
+    if (string == NULL) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+        return (fputs("[ERRO]: input is NULL\n", stderr), 0);
 #else
-        return NULL;
+        return 0;
 #endif
     }
     size_t current_char = 0;
-    const unsigned char *ptr = (const unsigned char *)src->cstr;
-    while (current_char < start) {
+    size_t length = 0;
+    const unsigned char *ptr = (const unsigned char *)string->cstr;
+
+    while (length <= string->length) {
         if (*ptr == 0) {
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
-#else
-            return NULL;
-#endif
+            return current_char;
         } else if ((*ptr & 0x80) == 0) {
             ptr++;
+            length++;
         } else if ((*ptr & 0xE0) == 0xC0) {
             ptr += 2;
+            length += 2;
         } else if ((*ptr & 0xF0) == 0xE0) {
             ptr += 3;
+            length += 3;
         } else if ((*ptr & 0xF8) == 0xF0) {
             ptr += 4;
+            length += 4;
         } else {
 #ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), 0);
 #else
-            return NULL;
+            return 0;
 #endif
         }
         current_char++;
     }
-    current_char = 0;
+    return current_char;
+}
 
-    const unsigned char *str = ptr;
-    size_t total_size = 0;
-    while (current_char < size) {
-        if (*str == 0) {
+size_t str_capacity(const string_t *string) {
+    return (size_t)string->capacity;
+}
+
+const char *str_cstr(const string_t *string) {
+    return (const char *)string->cstr;
+}
+
+const wchar_t *str_wstr(const string_t *string) {
+    wchar_t *res;
+    size_t size = mbstowcs(NULL, string->cstr, string->capacity);
+    if (size != (size_t)-1) {
+        res = str_mem_alloc(sizeof(wchar_t) * (size + 1));
+        if (res != NULL) {
+            mbstowcs(res, string->cstr, string->capacity);
+            return (const wchar_t *)res;
+        }
 #ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+        return (fputs("[ERRO]: run out of memory\n", stderr), NULL);
 #else
-            return NULL;
+        return NULL;
 #endif
-        } else if ((*str & 0x80) == 0) {
-            str++;
-            total_size++;
-        } else if ((*str & 0xE0) == 0xC0) {
-            str += 2;
-            total_size += 2;
-        } else if ((*str & 0xF0) == 0xE0) {
-            str += 3;
-            total_size += 3;
-        } else if ((*str & 0xF8) == 0xF0) {
-            str += 4;
-            total_size += 4;
-        } else {
+    }
 #ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+    return (fputs("[ERRO]: invalid multibyte sequence\n", stderr), NULL);
 #else
-            return NULL;
+    return NULL;
 #endif
-        }
-        current_char++;
-    }
+}
 
-    // create string
-    string_t *result = NULL;
-    if (str_resize(&result, total_size)) {
-        memcpy(result->cstr, ptr, total_size);
-        return result;
+bool str_clear(string_t **string) {
+    if (str_resize(string, 0)) {
+        // borrowed strings, like the tokens of str_split_packed, can hold less
+        size_t size = (*string)->capacity < 16 ? (*string)->capacity : 16;
+        memset((*string)->cstr, 0, sizeof(char) * size);
+        return true;
     }
-    return NULL;
+    return false;
 }
 
-string_t *str_strdup(const string_t *src) {
-    string_t *result = malloc(sizeof(string_t) + sizeof(char) * (src->capacity - 1));
-    if (result != NULL) {
-        memcpy(result, src, sizeof(string_t) + sizeof(char) * src->length);
-        return result;
+string_t *str_clear_to(string_t *old, string_t *new) {
+    str_free(old);
+    return new;
+}
+
+bool str_reserve(string_t **string, size_t length) {
+    size_t size = (*string)->length;
+    if (length < (*string)->capacity) {
+        return true;
     }
-#ifdef YASLI_DEBUG
-    return (fputs("[ERRO]: run out of memory\n", stderr), NULL);
-#else
-    return NULL;
-#endif
+    if (str_resize(string, length)) {
+        (*string)->length = size;
+        (*string)->cstr[size] = 0;
+        return true;
+    }
+    return false;
 }
 
-string_t *str_inserted_cstr(const string_t *src, size_t index, const char *in) {
-    if (index > src->length) {
+bool str_shrink_to_fit(string_t **string) {
+    size_t capacity = (*string)->length + 1;
+    if (capacity >= (*string)->capacity || str_block(*string)->owner == STR_OWNER_BORROWED) {
+        return true;
+    }
+#ifdef YASLI_REFCOUNT
+    // a shared block is left alone, the other owners still use it
+    if (atomic_load(&str_block(*string)->refs) > 1) {
+        return true;
+    }
+#endif  // YASLI_REFCOUNT
+    string_t *result = str_mem_realloc(*string, STR_HEADER + sizeof(char) * (*string)->capacity, STR_HEADER + sizeof(char) * capacity);
+    if (result == NULL) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bound\n", stderr), NULL);
+        return (fputs("[ERRO]: out of memory\n", stderr), false);
 #else
-        return NULL;
+        return false;
 #endif
     }
-    size_t size = strlen(in);
-    string_t *new_str = NULL;
-    if (str_resize(&new_str, src->length + size)) {
-        memmove(new_str->cstr, src->cstr, index);
-        memmove(new_str->cstr + index, in, size);
-        memmove(new_str->cstr + index + size, src->cstr + index, src->length - index + 1);
-        return new_str;
+    *string = result;
+    (*string)->capacity = capacity;
+    return true;
+}
+
+string_t *str_appended(const string_t *start, const string_t *end) {
+    size_t length = start->length + end->length;
+    string_t *result = NULL;
+    if (str_resize(&result, length)) {
+        strcpy(result->cstr, start->cstr);
+        strcpy(result->cstr + start->length, end->cstr);
+        return result;
     }
     return NULL;
 }
 
-string_t *str_insert_cstr(string_t **src, size_t index, const char *in) {
-    if (index > (*src)->length) {
-#ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bound\n", stderr), NULL);
-#else
-        return NULL;
-#endif
-    }
-    size_t size = strlen(in);
-    size_t len = (*src)->length;
-    if (str_resize(src, len + size)) {
-        memmove((*src)->cstr + index + size, (*src)->cstr + index, len - index + 1);
-        memmove((*src)->cstr + index, in, size);
-        return *src;
+string_t *str_append(string_t **start, const string_t *end) {
+    size_t length = (*start)->length;
+    if (str_resize(start, (*start)->length + end->length)) {
+        strcpy((*start)->cstr + length, end->cstr);
+        return *start;
     }
     return NULL;
 }
 
-string_t *str_replaced(const string_t *src, const char *old_val, const char *new_val) {
-    // creating string arrays
-    size_t old_len = strlen(old_val);
-    char *str = malloc(sizeof(char) * (src->length + 1));
-    strncpy(str, src->cstr, src->length + 1);
-    char *ptr = str;
-    size_t cap = 16;
-    char **tokens = malloc(sizeof(char *) * cap);
-    size_t *part_len = malloc(sizeof(size_t) * cap);
-    char *token;
-    size_t index = 0;
-    size_t counter = 0;
-    token = strstr(str, old_val);
-    while (token != NULL) {
-        *token = 0;
-        part_len[index] = strlen(str);
-        tokens[index] = malloc(sizeof(char) * (part_len[index] + 1));
-        strcpy(tokens[index], str);
-        str = token + old_len;
-        index++;
-        counter++;
-        token = strstr(str, old_val);
-        if (index + 2 == cap) {
-            cap += 16;
-            tokens = realloc(tokens, sizeof(char *) * cap);
-            part_len = realloc(part_len, sizeof(size_t) * cap);
-        }
-    }
-    part_len[index] = strlen(str);
-    tokens[index] = malloc(sizeof(char) * (part_len[index] + 1));
-    strcpy(tokens[index], str);
-    index++;
-    tokens[index] = NULL;
-    free(ptr);
-
-    // creating new string
+string_t *str_appendeds(const string_t *start, ...) {
+    va_list ap, _ap;
+    va_start(ap, start);
+    va_copy(_ap, ap);
     size_t length = 0;
-    size_t new_len = strlen(new_val);
-    for (size_t i = 0; tokens[i] != NULL; i++) {
-        length += strlen(tokens[i]);
-        if (counter != i) {
-            length += new_len;
-        }
+    for (const string_t *str = start; str != NULL; str = va_arg(ap, string_t *)) {
+        length += str->length;
     }
-    index = 0;
+    va_end(ap);
     string_t *result = NULL;
     if (str_resize(&result, length)) {
-        for (size_t i = 0; tokens[i] != NULL; i++) {
-            strcpy(result->cstr + index, tokens[i]);
-            index += part_len[i];
-            if (counter != i) {
-                strcpy(result->cstr + index, new_val);
-                index += new_len;
-            }
-            free(tokens[i]);
+        size_t index = 0;
+        for (const string_t *str = start; str != NULL; str = va_arg(_ap, string_t *)) {
+            strcpy(result->cstr + index, str->cstr);
+            index += str->length;
         }
-        free(tokens);
-        free(part_len);
+        va_end(_ap);
         return result;
     }
-    for (size_t i = 0; tokens[i] != NULL; i++) {
-        free(tokens[i]);
-    }
-    free(tokens);
-    free(part_len);
+    va_end(_ap);
     return NULL;
 }
 
-// built in compare function for str_sort and str_sorted
-static inline int str_cmp_l(const void *arg1, const void *arg2) {
-    string_t *str1 = *(string_t **)arg1;
-    string_t *str2 = *(string_t **)arg2;
-    return (str1->length - str2->length);
-}
-static inline int str_cmp_a(const void *arg1, const void *arg2) {
-    string_t *str1 = *(string_t **)arg1;
-    string_t *str2 = *(string_t **)arg2;
-    for (size_t i = 0; i <= str1->length && i <= str2->length; i++) {
-        if (str1->cstr[i] != str2->cstr[i]) {
-            return str1->cstr[i] - str2->cstr[i];
-        }
-    }
-    return 0;
-}
-static inline int str_cmp_la(const void *arg1, const void *arg2) {
-    string_t *str1 = *(string_t **)arg1;
-    string_t *str2 = *(string_t **)arg2;
-    if (str1->length != str2->length) {
-        return str1->length - str2->length;
-    } else {
-        for (size_t i = 0; i < str1->length; i++) {
-            if (str1->cstr[i] != str2->cstr[i]) {
-                return str1->cstr[i] - str2->cstr[i];
-            }
+string_t *str_appends(string_t **start, ...) {
+    va_list ap, _ap;
+    va_start(ap, start);
+    va_copy(_ap, ap);
+    size_t length = 0;
+    for (const string_t *str = *start; str != NULL; str = va_arg(ap, string_t *)) {
+        length += str->length;
+    }
+    va_end(ap);
+    size_t index = (*start)->length;
+    if (str_resize(start, length)) {
+        for (const string_t *str = va_arg(_ap, string_t *); str != NULL; str = va_arg(_ap, string_t *)) {
+            strcpy((*start)->cstr + index, str->cstr);
+            index += str->length;
         }
+        va_end(_ap);
+        return *start;
     }
-    return 0;
+    va_end(_ap);
+    return NULL;
 }
-static inline int str_cmp_ai(const void *arg1, const void *arg2) {
-    string_t *str1 = *(string_t **)arg1;
-    string_t *str2 = *(string_t **)arg2;
-    for (size_t i = 0; i <= str1->length && i <= str2->length; i++) {
-        if (toupper(str1->cstr[i]) != toupper(str2->cstr[i])) {
-            return toupper(str1->cstr[i]) - toupper(str2->cstr[i]);
-        }
+
+string_t *str_appended_cstr(const string_t *start, const char *end) {
+    size_t start_len = start->length;
+    size_t end_len = strlen(end);
+    string_t *result = NULL;
+    if (str_resize(&result, start_len + end_len)) {
+        strcpy(result->cstr, start->cstr);
+        strcpy(result->cstr + start_len, end);
+        result->cstr[result->length] = 0;
+        return result;
     }
-    return 0;
+    return NULL;
 }
-static inline int str_cmp_lai(const void *arg1, const void *arg2) {
-    string_t *str1 = *(string_t **)arg1;
-    string_t *str2 = *(string_t **)arg2;
-    if (str1->length != str2->length) {
-        return str1->length - str2->length;
-    } else {
-        for (size_t i = 0; i < str1->length; i++) {
-            if (toupper(str1->cstr[i]) != toupper(str2->cstr[i])) {
-                return toupper(str1->cstr[i]) - toupper(str2->cstr[i]);
-            }
+
+string_t *str_append_cstr(string_t **start, const char *end) {
+    size_t start_len = (*start)->length;
+    size_t end_len = strlen(end);
+    if (str_resize(start, (*start)->length + end_len)) {
+        strcpy((*start)->cstr + start_len, end);
+        return *start;
+    }
+    return NULL;
+}
+
+string_t *str_appended_cstrs(const string_t *start, ...) {
+    va_list ap, _ap;
+    va_start(ap, start);
+    va_copy(_ap, ap);
+    size_t length = 0;
+    for (const char *string = start->cstr; string != NULL; string = va_arg(ap, char *)) {
+        length += strlen(string);
+    }
+    va_end(ap);
+    string_t *result = NULL;
+    if (str_resize(&result, length)) {
+        size_t index = 0;
+        for (const char *string = start->cstr; string != NULL; string = va_arg(_ap, char *)) {
+            strcpy(result->cstr + index, string);
+            index += strlen(string);
         }
+        va_end(_ap);
+        return result;
     }
-    return 0;
+    va_end(_ap);
+    return NULL;
 }
 
-string_t **str_sort(string_t **src, size_t size, const char *mode, ...) {
-    enum modes { c, i, l, a, la, modes_max };
-    bool option[modes_max] = {0};
-    for (const char *ch = mode; *ch != 0; ch++) {
-        if (*ch == 'c') {
-            option[c] = true;
-            break;
-        } else if (*ch == 'i') {
-            option[i] = true;
-        } else if (*ch == 'l') {
-            if (option[a] == true) {
-                continue;
-            } else {
-                option[l] = true;
-            }
-        } else if (*ch == 'a') {
-            if (option[l] == true) {
-                option[l] = false;
-                option[la] = true;
-            } else {
-                option[a] = true;
-            }
-        } else {
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid mode\n", stderr), NULL);
-#else
-            return NULL;
-#endif
+string_t *str_append_cstrs(string_t **start, ...) {
+    va_list ap, _ap;
+    va_start(ap, start);
+    va_copy(_ap, ap);
+    size_t length = 0;
+    for (const char *string = (*start)->cstr; string != NULL; string = va_arg(ap, char *)) {
+        length += strlen(string);
+    }
+    va_end(ap);
+    size_t index = (*start)->length;
+    if (str_resize(start, length)) {
+        for (const char *string = va_arg(_ap, char *); string != NULL; string = va_arg(_ap, char *)) {
+            strcpy((*start)->cstr + index, string);
+            index += strlen(string);
         }
+        va_end(_ap);
+        return *start;
     }
-    if (size == 0) {
-        for (; src[size] != NULL; size++);
+    va_end(_ap);
+    return NULL;
+}
+
+// number of tokens str_split makes of src
+static size_t str_split_count(const string_t *src, const char *needle, size_t nlen) {
+    const char *end = src->cstr + src->length;
+    size_t count = 1;
+    if (nlen != 0) {
+        for (const char *token = str_memmem(src->cstr, src->length, needle, nlen); token != NULL; token = str_memmem(token + nlen, end - token - nlen, needle, nlen)) {
+            count++;
+        }
     }
-#ifdef _MSC_VER
-    void *temp;
-#endif
-    int (*compar)(const void *, const void *);
-    if (option[c] == true) {
-        va_list ap;
-        va_start(ap, mode);
-#ifdef _MSC_VER
-        temp = va_arg(ap, void *);
-        compar = (int (*)(const void *, const void *))temp;
-#else
-        compar = va_arg(ap, int (*)(const void *, const void *));
-#endif
-        va_end(ap);
-    } else if (option[l] == true) {
-        compar = str_cmp_l;
-    } else if (option[a] == true && option[i] == false) {
-        compar = str_cmp_a;
-    } else if (option[a] == true && option[i] == true) {
-        compar = str_cmp_ai;
-    } else if (option[la] == true) {
-        compar = str_cmp_la;
-    } else if (option[la] == true && option[i] == true) {
-        compar = str_cmp_lai;
-    } else {
+    return count;
+}
+
+string_t **str_split(const string_t *src, const char *needle) {
+    size_t nlen = strlen(needle);
+    size_t count = str_split_count(src, needle, nlen);
+    string_t **tokens = str_mem_alloc(sizeof(string_t *) * (count + 1));
+    if (tokens == NULL) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: invalid mode\n", stderr), NULL);
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
 #else
         return NULL;
 #endif
     }
-    qsort(src, size, sizeof(string_t *), compar);
-    return src;
-}
-
-string_t **str_sorted(string_t **src, size_t size, const char *mode, ...) {
-    enum modes { c, i, l, a, la, modes_max };
-    bool option[modes_max] = {0};
-    for (const char *ch = mode; *ch != 0; ch++) {
-        if (*ch == 'c') {
-            option[c] = true;
-            break;
-        } else if (*ch == 'i') {
-            option[i] = true;
-        } else if (*ch == 'l') {
-            if (option[a] == true) {
-                continue;
-            } else {
-                option[l] = true;
-            }
-        } else if (*ch == 'a') {
-            if (option[l] == true) {
-                option[l] = false;
-                option[la] = true;
-            } else {
-                option[a] = true;
-            }
-        } else {
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid mode\n", stderr), NULL);
-#else
+    const char *end = src->cstr + src->length;
+    const char *str = src->cstr;
+    for (size_t index = 0; index < count; index++) {
+        const char *token = index + 1 < count ? str_memmem(str, end - str, needle, nlen) : end;
+        tokens[index] = NULL;
+        if (!str_resize(&tokens[index], token - str)) {
+            tokens[index] = NULL;
+            str_free_arr(tokens);
             return NULL;
-#endif
         }
+        memcpy(tokens[index]->cstr, str, token - str);
+        str = token + nlen;
     }
-    if (size == 0) {
-        for (; src[size] != NULL; size++);
-    }
-#ifdef _MSC_VER
-    void *temp;
-#endif
-    int (*compar)(const void *, const void *);
-    if (option[c] == true) {
-        va_list ap;
-        va_start(ap, mode);
-#ifdef _MSC_VER
-        temp = va_arg(ap, void *);
-        compar = (int (*)(const void *, const void *))temp;
-#else
-        compar = va_arg(ap, int (*)(const void *, const void *));
-#endif
-        va_end(ap);
-    } else if (option[l] == true) {
-        compar = str_cmp_l;
-    } else if (option[a] == true && option[i] == false) {
-        compar = str_cmp_a;
-    } else if (option[a] == true && option[i] == true) {
-        compar = str_cmp_ai;
-    } else if (option[la] == true) {
-        compar = str_cmp_la;
-    } else if (option[la] == true && option[i] == true) {
-        compar = str_cmp_lai;
-    } else {
+    tokens[count] = NULL;
+    return tokens;
+}
+
+string_t **str_split_packed(const string_t *src, const char *needle) {
+    size_t nlen = strlen(needle);
+    size_t count = str_split_count(src, needle, nlen);
+    const char *end = src->cstr + src->length;
+
+    // the array and all the tokens share one allocation, tokens are tagged as
+    // borrowed so str_free_arr releases everything at once
+    size_t size = sizeof(string_t *) * (count + 1) + count * (sizeof(str_block_t) + STR_HEADER + STR_ALIGN) + src->length;
+    string_t **tokens = str_mem_alloc(size);
+    if (tokens == NULL) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: invalid mode\n", stderr), NULL);
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
 #else
         return NULL;
 #endif
     }
-    string_t **result = malloc(sizeof(string_t *) * (size + 1));
-    for (size_t i = 0; i < size; i++) {
-        result[i] = str_strdup(src[i]);
-    }
-    result[size] = NULL;
-    qsort(result, size, sizeof(string_t *), compar);
-    return result;
-}
-
-int str_strcmp(const string_t *str1, const string_t *str2) {
-    for (size_t i = 0; i <= str1->length && i <= str2->length; i++) {
-        if (str1->cstr[i] != str2->cstr[i]) {
-            return str1->cstr[i] - str2->cstr[i];
-        }
+    char *ptr = (char *)(tokens + count + 1);
+    const char *str = src->cstr;
+    for (size_t index = 0; index < count; index++) {
+        const char *token = index + 1 < count ? str_memmem(str, end - str, needle, nlen) : end;
+        size_t length = token - str;
+        size_t block_size = (sizeof(str_block_t) + STR_HEADER + length + 1 + STR_ALIGN - 1) / STR_ALIGN * STR_ALIGN;
+        str_block_t *block = (str_block_t *)ptr;
+        str_block_init(block, STR_OWNER_BORROWED);
+        tokens[index] = (string_t *)(block + 1);
+        tokens[index]->length = length;
+        tokens[index]->capacity = block_size - sizeof(str_block_t) - STR_HEADER;
+        memcpy(tokens[index]->cstr, str, length);
+        tokens[index]->cstr[length] = 0;
+        ptr += block_size;
+        str = token + nlen;
     }
-    return 0;
+    tokens[count] = NULL;
+    return tokens;
 }
 
-bool str_streq(const string_t *str1, const string_t *str2) {
-    if (str1->length != str2->length) {
-        return false;
+void str_to_upper(string_t *string) {
+#ifdef YASLI_REFCOUNT
+    if (str_is_shared(string)) {
+        return;
     }
-    for (size_t i = 0; i < str1->length; i++) {
-        if (str1->cstr[i] != str2->cstr[i]) {
-            return false;
-        }
+#endif  // YASLI_REFCOUNT
+    for (size_t i = 0; i < string->length; i++) {
+        string->cstr[i] = toupper(string->cstr[i]);
     }
-    return true;
 }
 
-bool str_start_with(const string_t *self, const char *str) {
-    size_t size = strlen(str);
-    if (self->length < size) {
-        return false;
+void str_to_lower(string_t *string) {
+#ifdef YASLI_REFCOUNT
+    if (str_is_shared(string)) {
+        return;
+    }
+#endif  // YASLI_REFCOUNT
+    for (size_t i = 0; i < string->length; i++) {
+        string->cstr[i] = tolower(string->cstr[i]);
     }
-    return (memcmp(self->cstr, str, size) == 0 ? true : false);
 }
 
-bool str_end_with(const string_t *self, const char *str) {
-    size_t size = strlen(str);
-    if (self->length < size) {
-        return false;
+string_t *str_upper(string_t **self) {
+#ifdef YASLI_REFCOUNT
+    if (!str_unshare(self)) {
+        return NULL;
     }
-    return (memcmp(self->cstr + (self->length - size), str, size) == 0 ? true : false);
+#endif  // YASLI_REFCOUNT
+    str_to_upper(*self);
+    return *self;
 }
 
-bool str_has(const string_t *self, const char *str) {
-    if (strstr(self->cstr, str)) {
-        return true;
+string_t *str_lower(string_t **self) {
+#ifdef YASLI_REFCOUNT
+    if (!str_unshare(self)) {
+        return NULL;
     }
-    return false;
+#endif  // YASLI_REFCOUNT
+    str_to_lower(*self);
+    return *self;
 }
 
-char str_char_at(string_t *self, size_t index, char new_val) {
-    if (index >= self->length) {
+string_t *str_substr(const string_t *src, size_t start, size_t size) {
+    if (start + size > src->length) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bounds\n", stderr), 0);
+        return (fputs("[ERRO]: index out of bound\n", stderr), NULL);
 #else
-        return 0;
+        return NULL;
 #endif
     }
-    if (new_val != 0) {
-        self->cstr[index] = new_val;
+    string_t *substr = NULL;
+    if (str_resize(&substr, size)) {
+        strncpy(substr->cstr, src->cstr + start, size);
+        substr->cstr[substr->length] = 0;
+        return substr;
     }
-    return self->cstr[index];
+    return NULL;
 }
 
-string_t *str_stripped(const string_t *src, const char *needle) {
-    size_t len = strlen(needle);
-    size_t lcount = 0;
-    size_t rcount = 0;
-    for (size_t i = 0; i < src->length; i++) {
-        for (size_t j = 0; j < len; j++) {
-            if (src->cstr[i] == needle[j]) {
-                lcount++;
-                goto lout;
-            }
-        }
-        break;
-    lout:
-        continue;
+string_t *str_utf8_substr(const string_t *src, size_t start, size_t size) {
+    if (start + size > src->length) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
     }
-    string_t *result = NULL;
-    if (lcount == src->length) {
-        if (str_resize(&result, 0)) {
-            return result;
+    size_t current_char = 0;
+    const unsigned char *ptr = (const unsigned char *)src->cstr;
+    while (current_char < start) {
+        if (*ptr == 0) {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        } else if ((*ptr & 0x80) == 0) {
+            ptr++;
+        } else if ((*ptr & 0xE0) == 0xC0) {
+            ptr += 2;
+        } else if ((*ptr & 0xF0) == 0xE0) {
+            ptr += 3;
+        } else if ((*ptr & 0xF8) == 0xF0) {
+            ptr += 4;
+        } else {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+#else
+            return NULL;
+#endif
         }
-        return NULL;
+        current_char++;
     }
-    for (size_t i = src->length - 1; i > 0; i--) {
-        for (size_t j = 0; j < len; j++) {
-            if (src->cstr[i] == needle[j]) {
-                rcount++;
-                goto rout;
-            }
+    current_char = 0;
+
+    const unsigned char *str = ptr;
+    size_t total_size = 0;
+    while (current_char < size) {
+        if (*str == 0) {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        } else if ((*str & 0x80) == 0) {
+            str++;
+            total_size++;
+        } else if ((*str & 0xE0) == 0xC0) {
+            str += 2;
+            total_size += 2;
+        } else if ((*str & 0xF0) == 0xE0) {
+            str += 3;
+            total_size += 3;
+        } else if ((*str & 0xF8) == 0xF0) {
+            str += 4;
+            total_size += 4;
+        } else {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+#else
+            return NULL;
+#endif
         }
-        break;
-    rout:
-        continue;
+        current_char++;
     }
-    if (str_resize(&result, (src->length - lcount - rcount))) {
-        memcpy(result->cstr, src->cstr + lcount, src->length - lcount - rcount);
-        result->cstr[result->length] = 0;
+
+    // create string
+    string_t *result = NULL;
+    if (str_resize(&result, total_size)) {
+        memcpy(result->cstr, ptr, total_size);
         return result;
     }
     return NULL;
 }
 
-string_t *str_strip(string_t **self, const char *needle) {
-    size_t len = strlen(needle);
-    size_t lcount = 0;
-    size_t rcount = 0;
-    for (size_t i = 0; i < (*self)->length; i++) {
-        for (size_t j = 0; j < len; j++) {
-            if ((*self)->cstr[i] == needle[j]) {
-                lcount++;
-                goto lout;
-            }
-        }
-        break;
-    lout:
-        continue;
+string_t *str_strdup(const string_t *src) {
+#ifdef YASLI_REFCOUNT
+    if (str_shareable(src)) {
+        atomic_fetch_add(&str_block(src)->refs, 1);
+        return (string_t *)src;
     }
-    if (lcount == (*self)->length) {
-        if (str_resize(self, 0)) {
-            (*self)->cstr[0] = 0;
-            return *self;
-        }
-        return NULL;
+#endif  // YASLI_REFCOUNT
+    string_t *result = NULL;
+    if (str_resize(&result, src->length)) {
+        memcpy(result->cstr, src->cstr, src->length);
+        return result;
     }
-    for (size_t i = (*self)->length - 1; i > 0; i--) {
-        for (size_t j = 0; j < len; j++) {
-            if ((*self)->cstr[i] == needle[j]) {
-                rcount++;
-                goto rout;
-            }
-        }
-        break;
-    rout:
-        continue;
+    return NULL;
+}
+
+string_t *str_inserted_cstr(const string_t *src, size_t index, const char *in) {
+    if (index > src->length) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bound\n", stderr), NULL);
+#else
+        return NULL;
+#endif
     }
-    memmove((*self)->cstr, (*self)->cstr + lcount, (*self)->length - lcount - rcount);
-    if (str_resize(self, ((*self)->length - lcount - rcount))) {
-        (*self)->cstr[(*self)->length] = 0;
-        return *self;
+    size_t size = strlen(in);
+    string_t *new_str = NULL;
+    if (str_resize(&new_str, src->length + size)) {
+        memmove(new_str->cstr, src->cstr, index);
+        memmove(new_str->cstr + index, in, size);
+        memmove(new_str->cstr + index + size, src->cstr + index, src->length - index + 1);
+        return new_str;
     }
     return NULL;
 }
 
-string_t *str_from_file(const char *file_name) {
-    errno = 0;
-    FILE *fp = fopen(file_name, "r");
-    if (fp == NULL) {
-        return (fprintf(stderr, "[ERRO]: failed opening file: \"%s\": %s\n", file_name, strerror(errno)), errno = 0, NULL);
+string_t *str_insert_cstr(string_t **src, size_t index, const char *in) {
+    if (index > (*src)->length) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bound\n", stderr), NULL);
+#else
+        return NULL;
+#endif
     }
-    fseek(fp, 0, SEEK_END);
-    size_t length = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    string_t *result = NULL;
-    if (str_resize(&result, length)) {
-        fread(result->cstr, sizeof(char), length, fp);
-        result->cstr[result->length] = 0;
-        fclose(fp);
-        return result;
+    size_t size = strlen(in);
+    size_t len = (*src)->length;
+    if (str_resize(src, len + size)) {
+        memmove((*src)->cstr + index + size, (*src)->cstr + index, len - index + 1);
+        memmove((*src)->cstr + index, in, size);
+        return *src;
     }
-    fclose(fp);
     return NULL;
 }
 
-bool str_isdigit(const string_t *src) {
-    for (size_t i = 0; i < src->length; i++) {
-        if (isdigit(src->cstr[i]) == false) {
-            return false;
+string_t *str_replaced(const string_t *src, const char *old_val, const char *new_val) {
+    size_t old_len = strlen(old_val);
+    size_t new_len = strlen(new_val);
+    const char *end = src->cstr + src->length;
+    // count first, so the result is allocated once with its final length
+    size_t count = 0;
+    if (old_len != 0) {
+        for (const char *token = str_memmem(src->cstr, src->length, old_val, old_len); token != NULL; token = str_memmem(token + old_len, end - token - old_len, old_val, old_len)) {
+            count++;
         }
     }
-    return true;
+    string_t *result = NULL;
+    if (!str_resize(&result, src->length - count * old_len + count * new_len)) {
+        return NULL;
+    }
+    const char *str = src->cstr;
+    char *dest = result->cstr;
+    for (size_t i = 0; i < count; i++) {
+        const char *token = str_memmem(str, end - str, old_val, old_len);
+        memcpy(dest, str, token - str);
+        dest += token - str;
+        memcpy(dest, new_val, new_len);
+        dest += new_len;
+        str = token + old_len;
+    }
+    memcpy(dest, str, end - str);
+    result->cstr[result->length] = 0;
+    return result;
 }
 
-bool str_isxdigit(const string_t *src) {
-    for (size_t i = 0; i < src->length; i++) {
-        if (isxdigit(src->cstr[i]) == false) {
-            if (i == 1) {
-                if ((src->cstr[i] == 'x' || src->cstr[i] == 'X') && src->cstr[0] == '0') {
-                    continue;
-                }
-            } else {
-                return false;
-            }
+// built in compare function for str_sort and str_sorted
+static inline int str_cmp_l(const void *arg1, const void *arg2) {
+    string_t *str1 = *(string_t **)arg1;
+    string_t *str2 = *(string_t **)arg2;
+    return (str1->length - str2->length);
+}
+static inline int str_cmp_a(const void *arg1, const void *arg2) {
+    string_t *str1 = *(string_t **)arg1;
+    string_t *str2 = *(string_t **)arg2;
+    for (size_t i = 0; i <= str1->length && i <= str2->length; i++) {
+        if (str1->cstr[i] != str2->cstr[i]) {
+            return str1->cstr[i] - str2->cstr[i];
         }
     }
-    return true;
+    return 0;
 }
-
-bool str_isfloat(const string_t *src) {
-    bool dot = false;
-    for (size_t i = 0; i < src->length; i++) {
-        if (isdigit(src->cstr[i]) == false) {
-            if (src->cstr[i] == '.') {
-                if (dot) {
-                    return false;
-                }
-                dot = true;
-            } else {
-                return false;
+static inline int str_cmp_la(const void *arg1, const void *arg2) {
+    string_t *str1 = *(string_t **)arg1;
+    string_t *str2 = *(string_t **)arg2;
+    if (str1->length != str2->length) {
+        return str1->length - str2->length;
+    } else {
+        for (size_t i = 0; i < str1->length; i++) {
+            if (str1->cstr[i] != str2->cstr[i]) {
+                return str1->cstr[i] - str2->cstr[i];
             }
         }
     }
-    return true;
+    return 0;
 }
-
-long str_strtol(const string_t *src, bool *err, int base) {
-    char *res = NULL;
-    errno = 0;
-    long result = strtol(src->cstr, &res, base);
-    if (errno != 0) {
-        if (err != NULL) {
-            *err = false;
-            return 0;
+static inline int str_cmp_ai(const void *arg1, const void *arg2) {
+    string_t *str1 = *(string_t **)arg1;
+    string_t *str2 = *(string_t **)arg2;
+    for (size_t i = 0; i <= str1->length && i <= str2->length; i++) {
+        if (toupper(str1->cstr[i]) != toupper(str2->cstr[i])) {
+            return toupper(str1->cstr[i]) - toupper(str2->cstr[i]);
         }
-        return 0;
     }
-    if (*res == 0 && (size_t)(res - src->cstr) == src->length) {
-        if (err != NULL) {
-            *err = true;
-            return result;
-        }
-        errno = EINVAL;
-        return result;
+    return 0;
+}
+static inline int str_cmp_lai(const void *arg1, const void *arg2) {
+    string_t *str1 = *(string_t **)arg1;
+    string_t *str2 = *(string_t **)arg2;
+    if (str1->length != str2->length) {
+        return str1->length - str2->length;
     } else {
-        if (err != NULL) {
-            *err = false;
-            return 0;
+        for (size_t i = 0; i < str1->length; i++) {
+            if (toupper(str1->cstr[i]) != toupper(str2->cstr[i])) {
+                return toupper(str1->cstr[i]) - toupper(str2->cstr[i]);
+            }
         }
-        errno = EINVAL;
-        return 0;
     }
+    return 0;
 }
 
-double str_strtod(const string_t *src, bool *err) {
-    char *res = NULL;
-    errno = 0;
-    double result = strtod(src->cstr, &res);
-    if (errno != 0) {
-        if (err != NULL) {
-            *err = false;
-            return 0;
+// the orders a sort mode string asks for
+enum { STR_SORT_C, STR_SORT_L, STR_SORT_A, STR_SORT_AI, STR_SORT_LA, STR_SORT_LAI, STR_SORT_INVALID };
+
+// parse the mode of str_sort and str_table_sort. c takes a compare function
+// and ends the mode, l sorts by length, a alphabetically, l then a by length
+// and then alphabetically, and i ignores the case of a
+static int str_sort_mode(const char *mode) {
+    enum modes { c, i, l, a, la, modes_max };
+    bool option[modes_max] = {0};
+    for (const char *ch = mode; *ch != 0; ch++) {
+        if (*ch == 'c') {
+            option[c] = true;
+            break;
+        } else if (*ch == 'i') {
+            option[i] = true;
+        } else if (*ch == 'l') {
+            if (option[a] == true) {
+                continue;
+            } else {
+                option[l] = true;
+            }
+        } else if (*ch == 'a') {
+            if (option[l] == true) {
+                option[l] = false;
+                option[la] = true;
+            } else {
+                option[a] = true;
+            }
+        } else {
+            return STR_SORT_INVALID;
         }
-        return 0;
     }
-    if (*res == 0 && (size_t)(res - src->cstr) == src->length) {
-        if (err != NULL) {
-            *err = true;
-            return result;
-        }
-        errno = EINVAL;
-        return result;
-    } else {
-        if (err != NULL) {
-            *err = false;
-            return 0;
-        }
-        errno = EINVAL;
-        return 0;
+    if (option[c] == true) {
+        return STR_SORT_C;
+    } else if (option[l] == true) {
+        return STR_SORT_L;
+    } else if (option[a] == true) {
+        return option[i] ? STR_SORT_AI : STR_SORT_A;
+    } else if (option[la] == true) {
+        return option[i] ? STR_SORT_LAI : STR_SORT_LA;
     }
+    return STR_SORT_INVALID;
 }
 
-char *str_utf8_char_at(string_t *self, size_t index) {
-    static char buf[5];
-    memset(buf, 0, sizeof(buf));
-
-    size_t current_char = 0;
-    const unsigned char *ptr = (const unsigned char *)self->cstr;
+// compare functions of str_sort and str_sorted by order, c takes its own
+static int (*const str_sort_compars[])(const void *, const void *) = {NULL, str_cmp_l, str_cmp_a, str_cmp_ai, str_cmp_la, str_cmp_lai};
 
-    while (current_char < index) {
-        if (*ptr == 0) {
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: index out of bounds\n", stderr), buf);
-#else
-            return buf;
-#endif
-        } else if ((*ptr & 0x80) == 0) {
-            ptr++;
-        } else if ((*ptr & 0xE0) == 0xC0) {
-            ptr += 2;
-        } else if ((*ptr & 0xF0) == 0xE0) {
-            ptr += 3;
-        } else if ((*ptr & 0xF8) == 0xF0) {
-            ptr += 4;
-        } else {
+string_t **str_sort(string_t **src, size_t size, const char *mode, ...) {
+    int order = str_sort_mode(mode);
+    if (order == STR_SORT_INVALID) {
 #ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), buf);
+        return (fputs("[ERRO]: invalid mode\n", stderr), NULL);
 #else
-            return buf;
+        return NULL;
 #endif
-        }
-        current_char++;
     }
-    if (*ptr == 0) {
-#ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bounds\n", stderr), buf);
-#else
-        return buf;
-#endif
-    } else if ((*ptr & 0x80) == 0) {
-        memcpy(buf, ptr, 1);
-        return buf;
-    } else if ((*ptr & 0xE0) == 0xC0) {
-        memcpy(buf, ptr, 2);
-        return buf;
-    } else if ((*ptr & 0xF0) == 0xE0) {
-        memcpy(buf, ptr, 3);
-        return buf;
-    } else if ((*ptr & 0xF8) == 0xF0) {
-        memcpy(buf, ptr, 4);
-        return buf;
+    if (size == 0) {
+        for (; src[size] != NULL; size++);
     }
-#ifdef YASLI_DEBUG
-    return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), buf);
+#ifdef _MSC_VER
+    void *temp;
+#endif
+    int (*compar)(const void *, const void *) = str_sort_compars[order];
+    if (order == STR_SORT_C) {
+        va_list ap;
+        va_start(ap, mode);
+#ifdef _MSC_VER
+        temp = va_arg(ap, void *);
+        compar = (int (*)(const void *, const void *))temp;
 #else
-    return buf;
+        compar = va_arg(ap, int (*)(const void *, const void *));
 #endif
+        va_end(ap);
+    }
+    qsort(src, size, sizeof(string_t *), compar);
+    return src;
 }
 
-int str_print(string_t *self, FILE *fp, const char *end) {
-    return fprintf(fp, "%s%s", self->cstr, end);
-}
-
-string_t *str_sliced(const string_t *src, int64_t start, int64_t end, int64_t step) {
-    if (step == 0) {
+string_t **str_sorted(string_t **src, size_t size, const char *mode, ...) {
+    int order = str_sort_mode(mode);
+    if (order == STR_SORT_INVALID) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: slice step cannot be zero\n", stderr), NULL);
+        return (fputs("[ERRO]: invalid mode\n", stderr), NULL);
 #else
         return NULL;
 #endif
     }
-    size_t start_index;
-    size_t end_index;
-    if (step > 0) {
-        start_index = start == YASLI_START ? 0 : start == YASLI_END ? src->length : start >= 0 ? (size_t)start : src->length + start;
-        end_index = end == YASLI_START ? 0 : end == YASLI_END ? src->length : end > 0 ? (size_t)end : src->length + end;
-    } else {
-        start_index = end == YASLI_START ? 0 : end == YASLI_END ? src->length : end == 0 ? (size_t)end + 1 : end > 0 ? (size_t)end + 1 : src->length + end + 1;
-        end_index = start == YASLI_START ? 0
-                    : start == YASLI_END ? src->length
-                    : start == 0         ? src->length
-                    : start > 0          ? (size_t)start + 1
-                                         : src->length + start + 1;
-    }
-    if (start_index > src->length) {
-        start_index = src->length;
-    }
-    if (end_index > src->length) {
-        end_index = src->length;
+    if (size == 0) {
+        for (; src[size] != NULL; size++);
     }
-    if (start_index > end_index) {
-#ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#ifdef _MSC_VER
+    void *temp;
+#endif
+    int (*compar)(const void *, const void *) = str_sort_compars[order];
+    if (order == STR_SORT_C) {
+        va_list ap;
+        va_start(ap, mode);
+#ifdef _MSC_VER
+        temp = va_arg(ap, void *);
+        compar = (int (*)(const void *, const void *))temp;
 #else
-        return NULL;
+        compar = va_arg(ap, int (*)(const void *, const void *));
 #endif
+        va_end(ap);
     }
-    size_t sub_len = end_index - start_index;
-    const char *ptr = src->cstr + start_index;
-    size_t abs_step = llabs(step);
-    size_t length = sub_len % abs_step == 0 ? sub_len / abs_step : sub_len / abs_step + 1;
-    string_t *result = NULL;
-    if (str_resize(&result, length)) {
-        size_t index = 0;
-        if (step > 0) {
-            for (size_t i = 0; i < sub_len; i += step) {
-                result->cstr[index++] = ptr[i];
-            }
-        } else {
-            // i <= sub_len for unsigned integer overflow
-            for (size_t i = sub_len - 1; i <= sub_len; i += step) {
-                result->cstr[index++] = ptr[i];
-            }
+    string_t **result = str_mem_alloc(sizeof(string_t *) * (size + 1));
+    for (size_t i = 0; i < size; i++) {
+        result[i] = str_strdup(src[i]);
+    }
+    result[size] = NULL;
+    qsort(result, size, sizeof(string_t *), compar);
+    return result;
+}
+
+int str_strcmp(const string_t *str1, const string_t *str2) {
+    for (size_t i = 0; i <= str1->length && i <= str2->length; i++) {
+        if (str1->cstr[i] != str2->cstr[i]) {
+            return str1->cstr[i] - str2->cstr[i];
         }
-        result->cstr[result->length] = 0;
-        return result;
     }
-    return NULL;
+    return 0;
 }
 
-string_t *str_slice(string_t **self, int64_t start, int64_t end, int64_t step) {
-    if (step == 0) {
-#ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: slice step cannot be zero\n", stderr), NULL);
-#else
-        return NULL;
-#endif
+bool str_streq(const string_t *str1, const string_t *str2) {
+    if (str1 == str2) {
+        return true;
     }
-    size_t start_index;
-    size_t end_index;
-    if (step > 0) {
-        start_index = start == YASLI_START ? 0 : start == YASLI_END ? (*self)->length : start >= 0 ? (size_t)start : (*self)->length + start;
-        end_index = end == YASLI_START ? 0 : end == YASLI_END ? (*self)->length : end > 0 ? (size_t)end : (*self)->length + end;
-    } else {
-        start_index = end == YASLI_START ? 0
-                      : end == YASLI_END ? (*self)->length
-                      : end == 0         ? (size_t)end + 1
-                      : end > 0          ? (size_t)end + 1
-                                         : (*self)->length + end + 1;
-        end_index = start == YASLI_START ? 0
-                    : start == YASLI_END ? (*self)->length
-                    : start == 0         ? (*self)->length
-                    : start > 0          ? (size_t)start + 1
-                                         : (*self)->length + start + 1;
+    // an intern pool holds each content once, so two of its strings are equal
+    // only if they are the same string
+    if (str_block(str1)->owner == str_block(str2)->owner && str_is_interned(str1)) {
+        return false;
     }
-    if (start_index > (*self)->length) {
-        start_index = (*self)->length;
+    if (str1->length != str2->length) {
+        return false;
     }
-    if (end_index > (*self)->length) {
-        end_index = (*self)->length;
+    for (size_t i = 0; i < str1->length; i++) {
+        if (str1->cstr[i] != str2->cstr[i]) {
+            return false;
+        }
     }
-    if (start_index > end_index) {
+    return true;
+}
+
+bool str_start_with(const string_t *self, const char *str) {
+    return str_view_start_with(str_view(self), str_view_cstr(str));
+}
+
+bool str_end_with(const string_t *self, const char *str) {
+    return str_view_end_with(str_view(self), str_view_cstr(str));
+}
+
+bool str_has(const string_t *self, const char *str) {
+    return str_view_has(str_view(self), str_view_cstr(str));
+}
+
+int64_t str_ifind(const string_t *src, const char *needle, size_t number) {
+    if (number == 0) {
+        return -1;
+    }
+    size_t nlen = strlen(needle);
+    // matches do not overlap, an empty needle matches at every index
+    size_t step = nlen != 0 ? nlen : 1;
+    for (size_t i = 0, offset = 0; offset <= src->length; i++) {
+        const char *ptr = str_memimem(src->cstr + offset, src->length - offset, needle, nlen);
+        if (ptr == NULL) {
+            return -1;
+        }
+        if (i + 1 == number) {
+            return (int64_t)(ptr - src->cstr);
+        }
+        offset = (size_t)(ptr - src->cstr) + step;
+    }
+    return -1;
+}
+
+bool str_ihas(const string_t *self, const char *str) {
+    return str_memimem(self->cstr, self->length, str, strlen(str)) != NULL;
+}
+
+bool str_istart_with(const string_t *self, const char *str) {
+    size_t len = strlen(str);
+    return len <= self->length && str_memieq(self->cstr, str, len);
+}
+
+bool str_iend_with(const string_t *self, const char *str) {
+    size_t len = strlen(str);
+    return len <= self->length && str_memieq(self->cstr + self->length - len, str, len);
+}
+
+bool str_istreq(const string_t *str1, const string_t *str2) {
+    return str1 == str2 || (str1->length == str2->length && str_memieq(str1->cstr, str2->cstr, str1->length));
+}
+
+char str_char_at(string_t *self, size_t index, char new_val) {
+    if (index >= self->length) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+        return (fputs("[ERRO]: index out of bounds\n", stderr), 0);
 #else
-        return NULL;
+        return 0;
 #endif
     }
-    size_t sub_len = end_index - start_index;
-    const char *ptr = (*self)->cstr + start_index;
-    size_t abs_step = llabs(step);
-    size_t length = sub_len % abs_step == 0 ? sub_len / abs_step : sub_len / abs_step + 1;
-#if defined(__STDC_NO_VLA__)
-    char *result = malloc(length);
+    if (new_val != 0) {
+#ifdef YASLI_REFCOUNT
+        if (str_is_shared(self)) {
+            return 0;
+        }
+#endif  // YASLI_REFCOUNT
+        self->cstr[index] = new_val;
+    }
+    return self->cstr[index];
+}
+
+string_t *str_set_char_at(string_t **self, size_t index, char new_val) {
+    if (index >= (*self)->length) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
 #else
-    char result[length];
+        return NULL;
 #endif
-    size_t index = 0;
-    if (step > 0) {
-        for (size_t i = 0; i < sub_len; i += step) {
-            result[index++] = ptr[i];
+    }
+#ifdef YASLI_REFCOUNT
+    if (!str_unshare(self)) {
+        return NULL;
+    }
+#endif  // YASLI_REFCOUNT
+    (*self)->cstr[index] = new_val;
+    return *self;
+}
+
+string_t *str_stripped(const string_t *src, const char *needle) {
+    size_t len = strlen(needle);
+    size_t lcount = 0;
+    size_t rcount = 0;
+    for (size_t i = 0; i < src->length; i++) {
+        for (size_t j = 0; j < len; j++) {
+            if (src->cstr[i] == needle[j]) {
+                lcount++;
+                goto lout;
+            }
         }
-    } else {
-        // i <= sub_len for unsigned integer overflow
-        for (size_t i = sub_len - 1; i <= sub_len; i += step) {
-            result[index++] = ptr[i];
+        break;
+    lout:
+        continue;
+    }
+    string_t *result = NULL;
+    if (lcount == src->length) {
+        if (str_resize(&result, 0)) {
+            return result;
+        }
+        return NULL;
+    }
+    for (size_t i = src->length - 1; i > 0; i--) {
+        for (size_t j = 0; j < len; j++) {
+            if (src->cstr[i] == needle[j]) {
+                rcount++;
+                goto rout;
+            }
         }
+        break;
+    rout:
+        continue;
     }
-    if (str_resize(self, length)) {
-        memcpy((*self)->cstr, result, length);
-        (*self)->cstr[(*self)->length] = 0;
-#ifdef __STDC_NO_VLA__
-        free(result);
-#endif
-        return *self;
+    if (str_resize(&result, (src->length - lcount - rcount))) {
+        memcpy(result->cstr, src->cstr + lcount, src->length - lcount - rcount);
+        result->cstr[result->length] = 0;
+        return result;
     }
-#ifdef __STDC_NO_VLA__
-    free(result);
-#endif
     return NULL;
 }
 
-string_t *str_utf8_sliced(const string_t *src, int64_t start, int64_t end, int64_t step) {
-    if (step == 0) {
-#ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: slice step cannot be zero\n", stderr), NULL);
-#else
+string_t *str_strip(string_t **self, const char *needle) {
+    size_t len = strlen(needle);
+    size_t lcount = 0;
+    size_t rcount = 0;
+    for (size_t i = 0; i < (*self)->length; i++) {
+        for (size_t j = 0; j < len; j++) {
+            if ((*self)->cstr[i] == needle[j]) {
+                lcount++;
+                goto lout;
+            }
+        }
+        break;
+    lout:
+        continue;
+    }
+    if (lcount == (*self)->length) {
+        if (str_resize(self, 0)) {
+            (*self)->cstr[0] = 0;
+            return *self;
+        }
         return NULL;
-#endif
     }
-    size_t str_length = str_utf8_strlen(src);
-    size_t start_index;
-    size_t end_index;
-    if (step > 0) {
-        start_index = start == YASLI_START ? 0 : start == YASLI_END ? str_length : start >= 0 ? (size_t)start : str_length + start;
-        end_index = end == YASLI_START ? 0 : end == YASLI_END ? str_length : end > 0 ? (size_t)end : str_length + end;
-    } else {
-        start_index = end == YASLI_START ? 0 : end == YASLI_END ? str_length : end == 0 ? (size_t)end + 1 : end > 0 ? (size_t)end + 1 : str_length + end + 1;
-        end_index = start == YASLI_START ? 0
-                    : start == YASLI_END ? str_length
-                    : start == 0         ? str_length
-                    : start > 0          ? (size_t)start + 1
-                                         : str_length + start + 1;
+    for (size_t i = (*self)->length - 1; i > 0; i--) {
+        for (size_t j = 0; j < len; j++) {
+            if ((*self)->cstr[i] == needle[j]) {
+                rcount++;
+                goto rout;
+            }
+        }
+        break;
+    rout:
+        continue;
     }
-    if (start_index > str_length) {
-        start_index = str_length;
+#ifdef YASLI_REFCOUNT
+    if (!str_unshare(self)) {
+        return NULL;
     }
-    if (end_index > str_length) {
-        end_index = str_length;
+#endif  // YASLI_REFCOUNT
+    memmove((*self)->cstr, (*self)->cstr + lcount, (*self)->length - lcount - rcount);
+    if (str_resize(self, ((*self)->length - lcount - rcount))) {
+        (*self)->cstr[(*self)->length] = 0;
+        return *self;
     }
-    if (start_index > end_index) {
-#ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
-#else
-        return NULL;
-#endif
+    return NULL;
+}
+
+string_t *str_from_file(const char *file_name) {
+    errno = 0;
+    FILE *fp = fopen(file_name, "r");
+    if (fp == NULL) {
+        return (fprintf(stderr, "[ERRO]: failed opening file: \"%s\": %s\n", file_name, strerror(errno)), errno = 0, NULL);
     }
-    size_t sub_len = end_index - start_index;
-    size_t abs_step = llabs(step);
+    fseek(fp, 0, SEEK_END);
+    size_t length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    string_t *result = NULL;
+    if (str_resize(&result, length)) {
+        fread(result->cstr, sizeof(char), length, fp);
+        result->cstr[result->length] = 0;
+        fclose(fp);
+        return result;
+    }
+    fclose(fp);
+    return NULL;
+}
 
-    // get to the starting index.
-    size_t current_char = 0;
-    const unsigned char *ptr = (const unsigned char *)src->cstr;
-    while (current_char < start_index) {
-        if (*ptr == 0) {
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
-#else
-            return NULL;
-#endif
-        } else if ((*ptr & 0x80) == 0) {
-            ptr++;
-        } else if ((*ptr & 0xE0) == 0xC0) {
-            ptr += 2;
-        } else if ((*ptr & 0xF0) == 0xE0) {
-            ptr += 3;
-        } else if ((*ptr & 0xF8) == 0xF0) {
-            ptr += 4;
-        } else {
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
-#else
-            return NULL;
-#endif
+bool str_isdigit(const string_t *src) {
+    for (size_t i = 0; i < src->length; i++) {
+        if (isdigit(src->cstr[i]) == false) {
+            return false;
         }
-        current_char++;
     }
+    return true;
+}
 
-    // get result length and utf-8 related information
-    current_char = 0;
-    const unsigned char *str = ptr;
-    size_t total_size = 0;
-#if defined(__STDC_NO_VLA__)
-    uint8_t *info = malloc(sizeof(uint8_t) * sub_len);
-#else
-    uint8_t info[sub_len];
-#endif
-
-    while (current_char < sub_len) {
-        if (*str == 0) {
-#if defined(__STDC_NO_VLA__)
-            free(info);
-#endif
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+bool str_isxdigit(const string_t *src) {
+    for (size_t i = 0; i < src->length; i++) {
+        if (isxdigit(src->cstr[i]) == false) {
+            if (i == 1) {
+                if ((src->cstr[i] == 'x' || src->cstr[i] == 'X') && src->cstr[0] == '0') {
+                    continue;
+                }
+            } else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool str_isfloat(const string_t *src) {
+    bool dot = false;
+    for (size_t i = 0; i < src->length; i++) {
+        if (isdigit(src->cstr[i]) == false) {
+            if (src->cstr[i] == '.') {
+                if (dot) {
+                    return false;
+                }
+                dot = true;
+            } else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+long str_strtol(const string_t *src, bool *err, int base) {
+    char *res = NULL;
+    errno = 0;
+    long result = strtol(src->cstr, &res, base);
+    if (errno != 0) {
+        if (err != NULL) {
+            *err = false;
+            return 0;
+        }
+        return 0;
+    }
+    if (*res == 0 && (size_t)(res - src->cstr) == src->length) {
+        if (err != NULL) {
+            *err = true;
+            return result;
+        }
+        errno = EINVAL;
+        return result;
+    } else {
+        if (err != NULL) {
+            *err = false;
+            return 0;
+        }
+        errno = EINVAL;
+        return 0;
+    }
+}
+
+double str_strtod(const string_t *src, bool *err) {
+    char *res = NULL;
+    errno = 0;
+    double result = strtod(src->cstr, &res);
+    if (errno != 0) {
+        if (err != NULL) {
+            *err = false;
+            return 0;
+        }
+        return 0;
+    }
+    if (*res == 0 && (size_t)(res - src->cstr) == src->length) {
+        if (err != NULL) {
+            *err = true;
+            return result;
+        }
+        errno = EINVAL;
+        return result;
+    } else {
+        if (err != NULL) {
+            *err = false;
+            return 0;
+        }
+        errno = EINVAL;
+        return 0;
+    }
+}
+
+char *str_utf8_char_at(string_t *self, size_t index) {
+    static char buf[5];
+    memset(buf, 0, sizeof(buf));
+
+    size_t current_char = 0;
+    const unsigned char *ptr = (const unsigned char *)self->cstr;
+
+    while (current_char < index) {
+        if (*ptr == 0) {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: index out of bounds\n", stderr), buf);
+#else
+            return buf;
+#endif
+        } else if ((*ptr & 0x80) == 0) {
+            ptr++;
+        } else if ((*ptr & 0xE0) == 0xC0) {
+            ptr += 2;
+        } else if ((*ptr & 0xF0) == 0xE0) {
+            ptr += 3;
+        } else if ((*ptr & 0xF8) == 0xF0) {
+            ptr += 4;
+        } else {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), buf);
+#else
+            return buf;
+#endif
+        }
+        current_char++;
+    }
+    if (*ptr == 0) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), buf);
+#else
+        return buf;
+#endif
+    } else if ((*ptr & 0x80) == 0) {
+        memcpy(buf, ptr, 1);
+        return buf;
+    } else if ((*ptr & 0xE0) == 0xC0) {
+        memcpy(buf, ptr, 2);
+        return buf;
+    } else if ((*ptr & 0xF0) == 0xE0) {
+        memcpy(buf, ptr, 3);
+        return buf;
+    } else if ((*ptr & 0xF8) == 0xF0) {
+        memcpy(buf, ptr, 4);
+        return buf;
+    }
+#ifdef YASLI_DEBUG
+    return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), buf);
+#else
+    return buf;
+#endif
+}
+
+int str_print(string_t *self, FILE *fp, const char *end) {
+    return fprintf(fp, "%s%s", self->cstr, end);
+}
+
+string_t *str_sliced(const string_t *src, int64_t start, int64_t end, int64_t step) {
+    if (step == 0) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: slice step cannot be zero\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    size_t start_index;
+    size_t end_index;
+    if (step > 0) {
+        start_index = start == YASLI_START ? 0 : start == YASLI_END ? src->length : start >= 0 ? (size_t)start : src->length + start;
+        end_index = end == YASLI_START ? 0 : end == YASLI_END ? src->length : end > 0 ? (size_t)end : src->length + end;
+    } else {
+        start_index = end == YASLI_START ? 0 : end == YASLI_END ? src->length : end == 0 ? (size_t)end + 1 : end > 0 ? (size_t)end + 1 : src->length + end + 1;
+        end_index = start == YASLI_START ? 0
+                    : start == YASLI_END ? src->length
+                    : start == 0         ? src->length
+                    : start > 0          ? (size_t)start + 1
+                                         : src->length + start + 1;
+    }
+    if (start_index > src->length) {
+        start_index = src->length;
+    }
+    if (end_index > src->length) {
+        end_index = src->length;
+    }
+    if (start_index > end_index) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    size_t sub_len = end_index - start_index;
+    const char *ptr = src->cstr + start_index;
+    size_t abs_step = llabs(step);
+    size_t length = sub_len % abs_step == 0 ? sub_len / abs_step : sub_len / abs_step + 1;
+    string_t *result = NULL;
+    if (str_resize(&result, length)) {
+        size_t index = 0;
+        if (step > 0) {
+            for (size_t i = 0; i < sub_len; i += step) {
+                result->cstr[index++] = ptr[i];
+            }
+        } else {
+            // i <= sub_len for unsigned integer overflow
+            for (size_t i = sub_len - 1; i <= sub_len; i += step) {
+                result->cstr[index++] = ptr[i];
+            }
+        }
+        result->cstr[result->length] = 0;
+        return result;
+    }
+    return NULL;
+}
+
+string_t *str_slice(string_t **self, int64_t start, int64_t end, int64_t step) {
+    if (step == 0) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: slice step cannot be zero\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    size_t start_index;
+    size_t end_index;
+    if (step > 0) {
+        start_index = start == YASLI_START ? 0 : start == YASLI_END ? (*self)->length : start >= 0 ? (size_t)start : (*self)->length + start;
+        end_index = end == YASLI_START ? 0 : end == YASLI_END ? (*self)->length : end > 0 ? (size_t)end : (*self)->length + end;
+    } else {
+        start_index = end == YASLI_START ? 0
+                      : end == YASLI_END ? (*self)->length
+                      : end == 0         ? (size_t)end + 1
+                      : end > 0          ? (size_t)end + 1
+                                         : (*self)->length + end + 1;
+        end_index = start == YASLI_START ? 0
+                    : start == YASLI_END ? (*self)->length
+                    : start == 0         ? (*self)->length
+                    : start > 0          ? (size_t)start + 1
+                                         : (*self)->length + start + 1;
+    }
+    if (start_index > (*self)->length) {
+        start_index = (*self)->length;
+    }
+    if (end_index > (*self)->length) {
+        end_index = (*self)->length;
+    }
+    if (start_index > end_index) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    size_t sub_len = end_index - start_index;
+    const char *ptr = (*self)->cstr + start_index;
+    size_t abs_step = llabs(step);
+    size_t length = sub_len % abs_step == 0 ? sub_len / abs_step : sub_len / abs_step + 1;
+#if defined(__STDC_NO_VLA__)
+    char *result = malloc(length);
+#else
+    char result[length];
+#endif
+    size_t index = 0;
+    if (step > 0) {
+        for (size_t i = 0; i < sub_len; i += step) {
+            result[index++] = ptr[i];
+        }
+    } else {
+        // i <= sub_len for unsigned integer overflow
+        for (size_t i = sub_len - 1; i <= sub_len; i += step) {
+            result[index++] = ptr[i];
+        }
+    }
+    if (str_resize(self, length)) {
+        memcpy((*self)->cstr, result, length);
+        (*self)->cstr[(*self)->length] = 0;
+#ifdef __STDC_NO_VLA__
+        free(result);
+#endif
+        return *self;
+    }
+#ifdef __STDC_NO_VLA__
+    free(result);
+#endif
+    return NULL;
+}
+
+string_t *str_utf8_sliced(const string_t *src, int64_t start, int64_t end, int64_t step) {
+    if (step == 0) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: slice step cannot be zero\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    size_t str_length = str_utf8_strlen(src);
+    size_t start_index;
+    size_t end_index;
+    if (step > 0) {
+        start_index = start == YASLI_START ? 0 : start == YASLI_END ? str_length : start >= 0 ? (size_t)start : str_length + start;
+        end_index = end == YASLI_START ? 0 : end == YASLI_END ? str_length : end > 0 ? (size_t)end : str_length + end;
+    } else {
+        start_index = end == YASLI_START ? 0 : end == YASLI_END ? str_length : end == 0 ? (size_t)end + 1 : end > 0 ? (size_t)end + 1 : str_length + end + 1;
+        end_index = start == YASLI_START ? 0
+                    : start == YASLI_END ? str_length
+                    : start == 0         ? str_length
+                    : start > 0          ? (size_t)start + 1
+                                         : str_length + start + 1;
+    }
+    if (start_index > str_length) {
+        start_index = str_length;
+    }
+    if (end_index > str_length) {
+        end_index = str_length;
+    }
+    if (start_index > end_index) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    size_t sub_len = end_index - start_index;
+    size_t abs_step = llabs(step);
+
+    // get to the starting index.
+    size_t current_char = 0;
+    const unsigned char *ptr = (const unsigned char *)src->cstr;
+    while (current_char < start_index) {
+        if (*ptr == 0) {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        } else if ((*ptr & 0x80) == 0) {
+            ptr++;
+        } else if ((*ptr & 0xE0) == 0xC0) {
+            ptr += 2;
+        } else if ((*ptr & 0xF0) == 0xE0) {
+            ptr += 3;
+        } else if ((*ptr & 0xF8) == 0xF0) {
+            ptr += 4;
+        } else {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        }
+        current_char++;
+    }
+
+    // get result length and utf-8 related information
+    current_char = 0;
+    const unsigned char *str = ptr;
+    size_t total_size = 0;
+#if defined(__STDC_NO_VLA__)
+    uint8_t *info = malloc(sizeof(uint8_t) * sub_len);
+#else
+    uint8_t info[sub_len];
+#endif
+
+    while (current_char < sub_len) {
+        if (*str == 0) {
+#if defined(__STDC_NO_VLA__)
+            free(info);
+#endif
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        } else if ((*str & 0x80) == 0) {
+            str++;
+            info[current_char] = 1;
+            if (step > 0) {
+                if (current_char % abs_step == 0) {
+                    total_size += 1;
+                }
+            } else {
+                if ((sub_len - current_char - 1) % abs_step == 0) {
+                    total_size += 1;
+                }
+            }
+        } else if ((*str & 0xE0) == 0xC0) {
+            str += 2;
+            info[current_char] = 2;
+            if (step > 0) {
+                if (current_char % abs_step == 0) {
+                    total_size += 2;
+                }
+            } else {
+                if ((sub_len - current_char - 1) % abs_step == 0) {
+                    total_size += 2;
+                }
+            }
+        } else if ((*str & 0xF0) == 0xE0) {
+            str += 3;
+            info[current_char] = 3;
+            if (step > 0) {
+                if (current_char % abs_step == 0) {
+                    total_size += 3;
+                }
+            } else {
+                if ((sub_len - current_char - 1) % abs_step == 0) {
+                    total_size += 3;
+                }
+            }
+        } else if ((*str & 0xF8) == 0xF0) {
+            str += 4;
+            info[current_char] = 4;
+            if (step > 0) {
+                if (current_char % abs_step == 0) {
+                    total_size += 4;
+                }
+            } else {
+                if ((sub_len - current_char - 1) % abs_step == 0) {
+                    total_size += 4;
+                }
+            }
+        } else {
+#if defined(__STDC_NO_VLA__)
+            free(info);
+#endif
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        }
+        current_char++;
+    }
+
+    string_t *result = NULL;
+    if (str_resize(&result, total_size)) {
+        size_t index = 0;
+        size_t curr = 0;
+        if (step > 0) {
+            for (size_t i = 0; i < sub_len;) {
+                memcpy(&result->cstr[index], &ptr[curr], info[i]);
+                index += info[i];
+                for (size_t j = 0; j < abs_step; j++) {
+                    if (i < sub_len) {
+                        curr += info[i];
+                        i++;
+                    }
+                }
+            }
+        } else {
+            curr = str - ptr - info[sub_len - 1];
+            // i <= sub_len for unsigned integer overflow
+            for (size_t i = sub_len - 1; i <= sub_len;) {
+                memcpy(&result->cstr[index], &ptr[curr], info[i]);
+                index += info[i];
+                for (size_t j = 0; j < abs_step; j++) {
+                    if (i <= sub_len) {
+                        curr -= info[i];
+                        i--;
+                    }
+                }
+            }
+        }
+        result->cstr[result->length] = 0;
+#if defined(__STDC_NO_VLA__)
+        free(info);
+#endif
+        return result;
+    }
+#if defined(__STDC_NO_VLA__)
+    free(info);
+#endif
+    return NULL;
+}
+
+string_t *str_utf8_slice(string_t **self, int64_t start, int64_t end, int64_t step) {
+    if (step == 0) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: slice step cannot be zero\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    size_t str_length = str_utf8_strlen(*self);
+    size_t start_index;
+    size_t end_index;
+    if (step > 0) {
+        start_index = start == YASLI_START ? 0 : start == YASLI_END ? str_length : start >= 0 ? (size_t)start : str_length + start;
+        end_index = end == YASLI_START ? 0 : end == YASLI_END ? str_length : end > 0 ? (size_t)end : str_length + end;
+    } else {
+        start_index = end == YASLI_START ? 0 : end == YASLI_END ? str_length : end == 0 ? (size_t)end + 1 : end > 0 ? (size_t)end + 1 : str_length + end + 1;
+        end_index = start == YASLI_START ? 0
+                    : start == YASLI_END ? str_length
+                    : start == 0         ? str_length
+                    : start > 0          ? (size_t)start + 1
+                                         : str_length + start + 1;
+    }
+    if (start_index > str_length) {
+        start_index = str_length;
+    }
+    if (end_index > str_length) {
+        end_index = str_length;
+    }
+    if (start_index > end_index) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    size_t sub_len = end_index - start_index;
+    size_t abs_step = llabs(step);
+
+    // get to the starting index.
+    size_t current_char = 0;
+    const unsigned char *ptr = (const unsigned char *)(*self)->cstr;
+    while (current_char < start_index) {
+        if (*ptr == 0) {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        } else if ((*ptr & 0x80) == 0) {
+            ptr++;
+        } else if ((*ptr & 0xE0) == 0xC0) {
+            ptr += 2;
+        } else if ((*ptr & 0xF0) == 0xE0) {
+            ptr += 3;
+        } else if ((*ptr & 0xF8) == 0xF0) {
+            ptr += 4;
+        } else {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        }
+        current_char++;
+    }
+
+    // get result length and utf-8 related information
+    current_char = 0;
+    const unsigned char *str = ptr;
+    size_t total_size = 0;
+#if defined(__STDC_NO_VLA__)
+    uint8_t *info = malloc(sizeof(uint8_t) * sub_len);
+#else
+    uint8_t info[sub_len];
+#endif
+
+    while (current_char < sub_len) {
+        if (*str == 0) {
+#if defined(__STDC_NO_VLA__)
+            free(info);
+#endif
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        } else if ((*str & 0x80) == 0) {
+            str++;
+            info[current_char] = 1;
+            if (step > 0) {
+                if (current_char % abs_step == 0) {
+                    total_size += 1;
+                }
+            } else {
+                if ((sub_len - current_char - 1) % abs_step == 0) {
+                    total_size += 1;
+                }
+            }
+        } else if ((*str & 0xE0) == 0xC0) {
+            str += 2;
+            info[current_char] = 2;
+            if (step > 0) {
+                if (current_char % abs_step == 0) {
+                    total_size += 2;
+                }
+            } else {
+                if ((sub_len - current_char - 1) % abs_step == 0) {
+                    total_size += 2;
+                }
+            }
+        } else if ((*str & 0xF0) == 0xE0) {
+            str += 3;
+            info[current_char] = 3;
+            if (step > 0) {
+                if (current_char % abs_step == 0) {
+                    total_size += 3;
+                }
+            } else {
+                if ((sub_len - current_char - 1) % abs_step == 0) {
+                    total_size += 3;
+                }
+            }
+        } else if ((*str & 0xF8) == 0xF0) {
+            str += 4;
+            info[current_char] = 4;
+            if (step > 0) {
+                if (current_char % abs_step == 0) {
+                    total_size += 4;
+                }
+            } else {
+                if ((sub_len - current_char - 1) % abs_step == 0) {
+                    total_size += 4;
+                }
+            }
+        } else {
+#if defined(__STDC_NO_VLA__)
+            free(info);
+#endif
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+#else
+            return NULL;
+#endif
+        }
+        current_char++;
+    }
+
+#if defined(__STDC_NO_VLA__)
+    char *result = malloc(sizeof(char) * total_size);
+#else
+    char result[total_size];
+#endif
+
+    size_t index = 0;
+    size_t curr = 0;
+    if (step > 0) {
+        for (size_t i = 0; i < sub_len;) {
+            memcpy(&result[index], &ptr[curr], info[i]);
+            index += info[i];
+            for (size_t j = 0; j < abs_step; j++) {
+                if (i < sub_len) {
+                    if (i <= sub_len) {
+                        curr -= info[i];
+                        i--;
+                    }
+                }
+            }
+        }
+    } else {
+        curr = str - ptr - info[sub_len - 1];
+        // i <= sub_len for unsigned integer overflow
+        for (size_t i = sub_len - 1; i <= sub_len;) {
+            memcpy(&result[index], &ptr[curr], info[i]);
+            index += info[i];
+            for (size_t j = 0; j < abs_step; j++) {
+                curr -= info[i];
+                i--;
+            }
+        }
+    }
+
+    if (str_resize(self, total_size)) {
+        memcpy((*self)->cstr, result, total_size);
+        (*self)->cstr[(*self)->length] = 0;
+#if defined(__STDC_NO_VLA__)
+        free(result);
+        free(info);
+#endif
+        return (*self);
+    }
+#if defined(__STDC_NO_VLA__)
+    free(result);
+    free(info);
+#endif
+    return NULL;
+}
+
+int64_t str_find(const string_t *src, const char *needle, size_t number) {
+    return str_view_find(str_view(src), str_view_cstr(needle), number);
+}
+
+// number of utf-8 characters in front of byte index index of src
+static int64_t str_utf8_index(const string_t *src, int64_t index) {
+    const char *match = src->cstr + index;
+    const char *ptr = src->cstr;
+    int64_t current_char = 0;
+    while (ptr < match) {
+        if ((*ptr & 0x80) == 0) {
+            ptr++;
+        } else if ((*ptr & 0xE0) == 0xC0) {
+            ptr += 2;
+        } else if ((*ptr & 0xF0) == 0xE0) {
+            ptr += 3;
+        } else if ((*ptr & 0xF8) == 0xF0) {
+            ptr += 4;
+        } else {
+#ifdef YASLI_DEBUG
+            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), 0);
+#else
+            return 0;
+#endif
+        }
+        current_char++;
+    }
+    return current_char;
+}
+
+int64_t str_utf8_find(const string_t *src, const char *needle, size_t number) {
+    int64_t index = str_view_find(str_view(src), str_view_cstr(needle), number);
+    return index < 0 ? -1 : str_utf8_index(src, index);
+}
+
+int64_t str_rfind(const string_t *src, const char *needle, size_t number) {
+    return str_view_rfind(str_view(src), str_view_cstr(needle), number);
+}
+
+int64_t str_utf8_rfind(const string_t *src, const char *needle, size_t number) {
+    int64_t index = str_view_rfind(str_view(src), str_view_cstr(needle), number);
+    return index < 0 ? -1 : str_utf8_index(src, index);
+}
+
+int64_t str_find_all(const string_t *src, const char *needle, bool overlapping, size_t **offsets, size_t *capacity) {
+    size_t nlen = strlen(needle);
+    // an empty needle matches at every index, and moving by one is the only
+    // way not to find the same match again
+    size_t step = nlen == 0 || overlapping ? 1 : nlen;
+    size_t count = 0;
+    // the search goes on from an index, a pointer could step past the end
+    const char *ptr;
+    for (size_t offset = 0; offset <= src->length && (ptr = str_memmem(src->cstr + offset, src->length - offset, needle, nlen)) != NULL;
+         offset = (size_t)(ptr - src->cstr) + step) {
+        if (*offsets == NULL || count == *capacity) {
+            size_t cap = *offsets == NULL ? 16 : *capacity * 2;
+            size_t *result = *offsets == NULL ? str_mem_alloc(sizeof(size_t) * cap) : str_mem_realloc(*offsets, sizeof(size_t) * *capacity, sizeof(size_t) * cap);
+            if (result == NULL) {
+#ifdef YASLI_DEBUG
+                return (fputs("[ERRO]: out of memory\n", stderr), -1);
+#else
+                return -1;
+#endif
+            }
+            *offsets = result;
+            *capacity = cap;
+        }
+        (*offsets)[count++] = ptr - src->cstr;
+    }
+    return (int64_t)count;
+}
+
+string_t *str_removed(const string_t *src, size_t index, size_t length) {
+    if (src == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: input is NULL\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    if (index + length > src->length) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    string_t *result = NULL;
+    if (str_resize(&result, src->length - length)) {
+        memmove(result->cstr, src->cstr, index);
+        memmove(result->cstr + index, src->cstr + index + length, src->length - index - length);
+        result->cstr[result->length] = 0;
+        return result;
+    }
+    return NULL;
+}
+
+string_t *str_remove(string_t **self, size_t index, size_t length) {
+    if ((*self) == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: input is NULL\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    if (index + length > (*self)->length) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+#ifdef YASLI_REFCOUNT
+    if (!str_unshare(self)) {
+        return NULL;
+    }
+#endif  // YASLI_REFCOUNT
+    memmove((*self)->cstr + index, (*self)->cstr + index + length, (*self)->length - index - length);
+    if (str_resize(self, (*self)->length - length)) {
+        (*self)->cstr[(*self)->length] = 0;
+        return (*self);
+    }
+    return NULL;
+}
+
+// str_hash is wyhash: every 16 bytes are folded with a 64x64->128 bit
+// multiply, three lanes at a time over long inputs. it is a plain
+// multiply, so the bulk loop keeps up with memory without vectors
+static const uint64_t str_hash_secret[4] = {0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL};
+
+// replace a and b with the low and the high half of their product
+static inline void str_hash_mum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 product = (unsigned __int128)*a * *b;
+    *a = (uint64_t)product;
+    *b = (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t middle = (ll >> 32) + (uint32_t)hl + lh;
+    *a = (middle << 32) | (uint32_t)ll;
+    *b = hh + (hl >> 32) + (middle >> 32);
+#endif
+}
+
+static inline uint64_t str_hash_mix(uint64_t a, uint64_t b) {
+    str_hash_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t str_hash_read64(const unsigned char *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t str_hash_read32(const unsigned char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t str_hash_bytes(const char *src, size_t length, uint64_t seed) {
+    const unsigned char *p = (const unsigned char *)src;
+    const uint64_t *secret = str_hash_secret;
+    seed ^= str_hash_mix(seed ^ secret[0], secret[1]);
+    uint64_t a, b;
+    if (length <= 16) {
+        if (length >= 4) {
+            // two overlapping pairs of words cover 4 to 16 bytes
+            size_t shift = (length >> 3) << 2;
+            a = (str_hash_read32(p) << 32) | str_hash_read32(p + shift);
+            b = (str_hash_read32(p + length - 4) << 32) | str_hash_read32(p + length - 4 - shift);
+        } else if (length > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = length;
+        if (i > 48) {
+            uint64_t lane1 = seed, lane2 = seed;
+            do {
+                seed = str_hash_mix(str_hash_read64(p) ^ secret[1], str_hash_read64(p + 8) ^ seed);
+                lane1 = str_hash_mix(str_hash_read64(p + 16) ^ secret[2], str_hash_read64(p + 24) ^ lane1);
+                lane2 = str_hash_mix(str_hash_read64(p + 32) ^ secret[3], str_hash_read64(p + 40) ^ lane2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (i > 16) {
+            seed = str_hash_mix(str_hash_read64(p) ^ secret[1], str_hash_read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        // the last 16 bytes, which may overlap the ones already mixed
+        a = str_hash_read64(p + i - 16);
+        b = str_hash_read64(p + i - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    str_hash_mum(&a, &b);
+    return str_hash_mix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+static inline uint64_t str_intern_hash(const char *src, size_t length) {
+    return str_hash_bytes(src, length, 0);
+}
+
+typedef struct str_slot_t {
+    uint64_t hash;
+    // id + 1 of the string in the slot, 0 for an empty slot
+    size_t id;
+} str_slot_t;
+
+struct str_intern_t {
+    // holds the canonical strings
+    str_arena_t *arena;
+    // canonical strings by id
+    const string_t **strings;
+    size_t count;
+    size_t capacity;
+    // open addressing table with linear probing, the size is a power of two
+    str_slot_t *slots;
+    size_t slot_count;
+    const str_allocator_t *allocator;
+};
+
+// the pool used when NULL is passed as pool
+static str_intern_t *str_intern_global = NULL;
+
+str_intern_t *str_intern_new(void) {
+    const str_allocator_t *allocator = str_get_allocator();
+    str_intern_t *pool = str_raw_alloc(allocator, sizeof(str_intern_t));
+    if (pool == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    pool->arena = str_arena_new(0);
+    pool->slot_count = 64;
+    pool->slots = str_raw_alloc(allocator, sizeof(str_slot_t) * pool->slot_count);
+    pool->capacity = 32;
+    pool->strings = str_raw_alloc(allocator, sizeof(string_t *) * pool->capacity);
+    pool->count = 0;
+    pool->allocator = allocator;
+    if (pool->arena == NULL || pool->slots == NULL || pool->strings == NULL) {
+        str_intern_free(pool);
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    pool->arena->intern = true;
+    memset(pool->slots, 0, sizeof(str_slot_t) * pool->slot_count);
+    return pool;
+}
+
+void str_intern_free(str_intern_t *pool) {
+    if (pool == NULL) {
+        pool = str_intern_global;
+        str_intern_global = NULL;
+        if (pool == NULL) {
+            return;
+        }
+    }
+    str_arena_free(pool->arena);
+    if (pool->slots != NULL) {
+        str_raw_free(pool->allocator, pool->slots);
+    }
+    if (pool->strings != NULL) {
+        str_raw_free(pool->allocator, pool->strings);
+    }
+    str_raw_free(pool->allocator, pool);
+}
+
+static inline str_intern_t *str_intern_pool(str_intern_t *pool) {
+    if (pool == NULL) {
+        if (str_intern_global == NULL) {
+            str_intern_global = str_intern_new();
+        }
+        return str_intern_global;
+    }
+    return pool;
+}
+
+// slot that holds src, or the empty slot where it belongs
+static str_slot_t *str_intern_slot(const str_intern_t *pool, const char *src, size_t length, uint64_t hash) {
+    size_t mask = pool->slot_count - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        str_slot_t *slot = &pool->slots[i];
+        if (slot->id == 0) {
+            return slot;
+        }
+        const string_t *string = pool->strings[slot->id - 1];
+        if (slot->hash == hash && string->length == length && memcmp(string->cstr, src, length) == 0) {
+            return slot;
+        }
+    }
+}
+
+static bool str_intern_grow(str_intern_t *pool) {
+    size_t slot_count = pool->slot_count * 2;
+    str_slot_t *slots = str_raw_alloc(pool->allocator, sizeof(str_slot_t) * slot_count);
+    if (slots == NULL) {
+        return false;
+    }
+    memset(slots, 0, sizeof(str_slot_t) * slot_count);
+    for (size_t i = 0; i < pool->slot_count; i++) {
+        if (pool->slots[i].id == 0) {
+            continue;
+        }
+        size_t j = pool->slots[i].hash & (slot_count - 1);
+        while (slots[j].id != 0) {
+            j = (j + 1) & (slot_count - 1);
+        }
+        slots[j] = pool->slots[i];
+    }
+    str_raw_free(pool->allocator, pool->slots);
+    pool->slots = slots;
+    pool->slot_count = slot_count;
+    return true;
+}
+
+static const string_t *str_intern_view(str_intern_t *pool, const char *src, size_t length) {
+    pool = str_intern_pool(pool);
+    if (pool == NULL) {
+        return NULL;
+    }
+    uint64_t hash = str_intern_hash(src, length);
+    str_slot_t *slot = str_intern_slot(pool, src, length, hash);
+    if (slot->id != 0) {
+        return pool->strings[slot->id - 1];
+    }
+
+    // keep the table at most half full
+    if ((pool->count + 1) * 2 > pool->slot_count) {
+        if (!str_intern_grow(pool)) {
+            goto oom;
+        }
+        slot = str_intern_slot(pool, src, length, hash);
+    }
+    if (pool->count == pool->capacity) {
+        const string_t **strings = str_raw_alloc(pool->allocator, sizeof(string_t *) * pool->capacity * 2);
+        if (strings == NULL) {
+            goto oom;
+        }
+        memcpy(strings, pool->strings, sizeof(string_t *) * pool->count);
+        str_raw_free(pool->allocator, pool->strings);
+        pool->strings = strings;
+        pool->capacity *= 2;
+    }
+    string_t *string = str_arena_alloc(pool->arena, STR_HEADER + sizeof(char) * (length + 1));
+    if (string == NULL) {
+        goto oom;
+    }
+    string->length = length;
+    string->capacity = length + 1;
+    memcpy(string->cstr, src, length);
+    string->cstr[length] = 0;
+    pool->strings[pool->count++] = string;
+    slot->hash = hash;
+    slot->id = pool->count;
+    return string;
+oom:
+#ifdef YASLI_DEBUG
+    return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+    return NULL;
+#endif
+}
+
+const string_t *str_intern(str_intern_t *pool, const char *src) {
+    return str_intern_view(pool, src, strlen(src));
+}
+
+const string_t *str_intern_string(str_intern_t *pool, const string_t *src) {
+    return str_intern_view(pool, src->cstr, src->length);
+}
+
+int64_t str_intern_id(str_intern_t *pool, const string_t *src) {
+    pool = pool != NULL ? pool : str_intern_global;
+    if (pool == NULL) {
+        return -1;
+    }
+    str_slot_t *slot = str_intern_slot(pool, src->cstr, src->length, str_intern_hash(src->cstr, src->length));
+    return (int64_t)slot->id - 1;
+}
+
+const string_t *str_intern_at(str_intern_t *pool, size_t id) {
+    pool = pool != NULL ? pool : str_intern_global;
+    if (pool == NULL || id >= pool->count) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    return pool->strings[id];
+}
+
+size_t str_intern_count(const str_intern_t *pool) {
+    pool = pool != NULL ? pool : str_intern_global;
+    return pool != NULL ? pool->count : 0;
+}
+
+str_view_t str_view(const string_t *src) {
+    return (str_view_t){src->cstr, src->length};
+}
+
+str_view_t str_view_cstr(const char *src) {
+    return (str_view_t){src, strlen(src)};
+}
+
+str_view_t str_view_substr(str_view_t src, size_t start, size_t size) {
+    if (start > src.length || size > src.length - start) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bound\n", stderr), (str_view_t){NULL, 0});
+#else
+        return (str_view_t){NULL, 0};
+#endif
+    }
+    return (str_view_t){src.data + start, size};
+}
+
+string_t *str_new_view(str_view_t src) {
+    string_t *string = NULL;
+    if (str_resize(&string, src.length)) {
+        memcpy(string->cstr, src.data, src.length);
+        return string;
+    }
+    return NULL;
+}
+
+int64_t str_view_find(str_view_t src, str_view_t needle, size_t number) {
+    if (number == 0) {
+        return -1;
+    }
+    // matches do not overlap, an empty needle matches at every index
+    size_t step = needle.length != 0 ? needle.length : 1;
+    for (size_t i = 0, offset = 0; offset <= src.length; i++) {
+        const char *ptr = str_memmem(src.data + offset, src.length - offset, needle.data, needle.length);
+        if (ptr == NULL) {
+            return -1;
+        }
+        if (i + 1 == number) {
+            return (int64_t)(ptr - src.data);
+        }
+        offset = (size_t)(ptr - src.data) + step;
+    }
+    return -1;
+}
+
+int64_t str_view_rfind(str_view_t src, str_view_t needle, size_t number) {
+    if (number == 0) {
+        return -1;
+    }
+    size_t length = src.length;
+    for (size_t i = 0;; i++) {
+        const char *ptr = str_memrmem(src.data, length, needle.data, needle.length);
+        if (ptr == NULL) {
+            return -1;
+        }
+        if (i + 1 == number) {
+            return (int64_t)(ptr - src.data);
+        }
+        // the next match has to end before this one starts, an empty needle
+        // matches at every index
+        if (needle.length == 0 && ptr == src.data) {
+            return -1;
+        }
+        length = ptr - src.data - (needle.length == 0 ? 1 : 0);
+    }
+}
+
+str_view_t *str_view_split(str_view_t src, str_view_t needle, size_t *count) {
+    size_t cap = 16;
+    size_t index = 0;
+    str_view_t *tokens = str_mem_alloc(sizeof(str_view_t) * cap);
+    if (tokens == NULL) {
+        goto oom;
+    }
+    const char *ptr = src.data;
+    const char *end = src.data + src.length;
+    const char *token = needle.length != 0 ? str_memmem(ptr, end - ptr, needle.data, needle.length) : NULL;
+    for (;;) {
+        // one slot is always left for the terminating view
+        if (index + 2 > cap) {
+            str_view_t *result = str_mem_realloc(tokens, sizeof(str_view_t) * cap, sizeof(str_view_t) * cap * 2);
+            if (result == NULL) {
+                str_mem_free(tokens);
+                goto oom;
+            }
+            tokens = result;
+            cap *= 2;
+        }
+        if (token == NULL) {
+            tokens[index++] = (str_view_t){ptr, end - ptr};
+            break;
+        }
+        tokens[index++] = (str_view_t){ptr, token - ptr};
+        ptr = token + needle.length;
+        token = str_memmem(ptr, end - ptr, needle.data, needle.length);
+    }
+    tokens[index] = (str_view_t){NULL, 0};
+    if (count != NULL) {
+        *count = index;
+    }
+    return tokens;
+oom:
+#ifdef YASLI_DEBUG
+    return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+    return NULL;
+#endif
+}
+
+bool str_view_has(str_view_t src, str_view_t needle) {
+    return str_memmem(src.data, src.length, needle.data, needle.length) != NULL;
+}
+
+bool str_view_start_with(str_view_t src, str_view_t prefix) {
+    if (src.length < prefix.length) {
+        return false;
+    }
+    return memcmp(src.data, prefix.data, prefix.length) == 0;
+}
+
+bool str_view_end_with(str_view_t src, str_view_t suffix) {
+    if (src.length < suffix.length) {
+        return false;
+    }
+    return memcmp(src.data + (src.length - suffix.length), suffix.data, suffix.length) == 0;
+}
+
+int str_view_strcmp(str_view_t str1, str_view_t str2) {
+    int result = memcmp(str1.data, str2.data, str1.length < str2.length ? str1.length : str2.length);
+    if (result != 0) {
+        return result;
+    }
+    return str1.length < str2.length ? -1 : str1.length > str2.length ? 1 : 0;
+}
+
+bool str_view_streq(str_view_t str1, str_view_t str2) {
+    return str1.length == str2.length && memcmp(str1.data, str2.data, str1.length) == 0;
+}
+
+// text shared by the rope nodes that point into it, never modified once written
+typedef struct str_rope_text_t {
+    size_t refs;
+    const str_allocator_t *allocator;
+    char data[];
+} str_rope_text_t;
+
+// nodes are immutable and may be shared by several ropes, every edit builds new
+// nodes along the touched paths and keeps the rest of the tree
+typedef struct str_rope_node_t {
+    struct str_rope_node_t *left;
+    struct str_rope_node_t *right;
+    str_rope_text_t *text;
+    // the piece of text held by this node
+    const char *data;
+    size_t size;
+    // bytes in the whole subtree
+    size_t length;
+    size_t refs;
+    uint64_t priority;
+    const str_allocator_t *allocator;
+} str_rope_node_t;
+
+struct str_rope_t {
+    str_rope_node_t *root;
+    uint64_t seed;
+    const str_allocator_t *allocator;
+};
+
+static inline size_t str_rope_len(const str_rope_node_t *node) {
+    return node != NULL ? node->length : 0;
+}
+
+static inline str_rope_node_t *str_rope_retain(str_rope_node_t *node) {
+    if (node != NULL) {
+        node->refs++;
+    }
+    return node;
+}
+
+static void str_rope_release(str_rope_node_t *node) {
+    while (node != NULL && --node->refs == 0) {
+        str_rope_node_t *right = node->right;
+        str_rope_release(node->left);
+        if (--node->text->refs == 0) {
+            str_raw_free(node->text->allocator, node->text);
+        }
+        str_raw_free(node->allocator, node);
+        node = right;
+    }
+}
+
+// xorshift64, treap priorities only need to look random
+static inline uint64_t str_rope_random(str_rope_t *rope) {
+    rope->seed ^= rope->seed << 13;
+    rope->seed ^= rope->seed >> 7;
+    rope->seed ^= rope->seed << 17;
+    return rope->seed;
+}
+
+// copy of node with new children and piece, NULL on failure
+static str_rope_node_t *str_rope_clone(const str_rope_node_t *node, str_rope_node_t *left, const char *data, size_t size, str_rope_node_t *right) {
+    str_rope_node_t *clone = str_raw_alloc(node->allocator, sizeof(str_rope_node_t));
+    if (clone == NULL) {
+        return NULL;
+    }
+    clone->left = str_rope_retain(left);
+    clone->right = str_rope_retain(right);
+    clone->text = node->text;
+    clone->text->refs++;
+    clone->data = data;
+    clone->size = size;
+    clone->length = str_rope_len(left) + size + str_rope_len(right);
+    clone->refs = 1;
+    clone->priority = node->priority;
+    clone->allocator = node->allocator;
+    return clone;
+}
+
+// split node into its first index bytes and the rest. node is left untouched,
+// left and right are new references
+static bool str_rope_split(str_rope_node_t *node, size_t index, str_rope_node_t **left, str_rope_node_t **right) {
+    *left = NULL;
+    *right = NULL;
+    if (index == 0 || index >= str_rope_len(node)) {
+        *(index == 0 ? right : left) = str_rope_retain(node);
+        return true;
+    }
+    size_t lsize = str_rope_len(node->left);
+    str_rope_node_t *l = NULL;
+    str_rope_node_t *r = NULL;
+    if (index <= lsize) {
+        if (!str_rope_split(node->left, index, &l, &r)) {
+            return false;
+        }
+        *left = l;
+        *right = str_rope_clone(node, r, node->data, node->size, node->right);
+        str_rope_release(r);
+    } else if (index >= lsize + node->size) {
+        if (!str_rope_split(node->right, index - lsize - node->size, &l, &r)) {
+            return false;
+        }
+        *left = str_rope_clone(node, node->left, node->data, node->size, l);
+        *right = r;
+        str_rope_release(l);
+    } else {
+        size_t offset = index - lsize;
+        *left = str_rope_clone(node, node->left, node->data, offset, NULL);
+        *right = str_rope_clone(node, NULL, node->data + offset, node->size - offset, node->right);
+    }
+    if (*left == NULL || *right == NULL) {
+        str_rope_release(*left);
+        str_rope_release(*right);
+        *left = NULL;
+        *right = NULL;
+        return false;
+    }
+    return true;
+}
+
+// concatenate left and right into a new reference in result, both are left
+// untouched
+static bool str_rope_merge(str_rope_node_t *left, str_rope_node_t *right, str_rope_node_t **result) {
+    if (left == NULL || right == NULL) {
+        *result = str_rope_retain(left != NULL ? left : right);
+        return true;
+    }
+    str_rope_node_t *merged = NULL;
+    if (left->priority > right->priority) {
+        if (!str_rope_merge(left->right, right, &merged)) {
+            return false;
+        }
+        *result = str_rope_clone(left, left->left, left->data, left->size, merged);
+    } else {
+        if (!str_rope_merge(left, right->left, &merged)) {
+            return false;
+        }
+        *result = str_rope_clone(right, merged, right->data, right->size, right->right);
+    }
+    str_rope_release(merged);
+    return *result != NULL;
+}
+
+// a single node holding a copy of src
+static str_rope_node_t *str_rope_leaf(str_rope_t *rope, const char *src, size_t length) {
+    if (length == 0) {
+        return NULL;
+    }
+    str_rope_text_t *text = str_raw_alloc(rope->allocator, sizeof(str_rope_text_t) + length);
+    str_rope_node_t *node = str_raw_alloc(rope->allocator, sizeof(str_rope_node_t));
+    if (text == NULL || node == NULL) {
+        if (text != NULL) {
+            str_raw_free(rope->allocator, text);
+        }
+        if (node != NULL) {
+            str_raw_free(rope->allocator, node);
+        }
+        return NULL;
+    }
+    text->refs = 1;
+    text->allocator = rope->allocator;
+    memcpy(text->data, src, length);
+    node->left = NULL;
+    node->right = NULL;
+    node->text = text;
+    node->data = text->data;
+    node->size = length;
+    node->length = length;
+    node->refs = 1;
+    node->priority = str_rope_random(rope);
+    node->allocator = rope->allocator;
+    return node;
+}
+
+static str_rope_t *str_rope_alloc(void) {
+    const str_allocator_t *allocator = str_get_allocator();
+    str_rope_t *rope = str_raw_alloc(allocator, sizeof(str_rope_t));
+    if (rope == NULL) {
+        return NULL;
+    }
+    rope->root = NULL;
+    rope->seed = (uintptr_t)rope ^ 0x9e3779b97f4a7c15ULL;
+    rope->allocator = allocator;
+    return rope;
+}
+
+static str_rope_t *str_rope_new_view(const char *src, size_t length) {
+    str_rope_t *rope = str_rope_alloc();
+    if (rope == NULL) {
+        goto oom;
+    }
+    rope->root = str_rope_leaf(rope, src, length);
+    if (rope->root == NULL && length != 0) {
+        str_rope_free(rope);
+        goto oom;
+    }
+    return rope;
+oom:
+#ifdef YASLI_DEBUG
+    return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+    return NULL;
+#endif
+}
+
+str_rope_t *str_rope_new(const char *src) {
+    return str_rope_new_view(src, strlen(src));
+}
+
+str_rope_t *str_rope_from_string(const string_t *src) {
+    return str_rope_new_view(src->cstr, src->length);
+}
+
+void str_rope_free(str_rope_t *rope) {
+    if (rope != NULL) {
+        str_rope_release(rope->root);
+        str_raw_free(rope->allocator, rope);
+    }
+}
+
+size_t str_rope_length(const str_rope_t *rope) {
+    return str_rope_len(rope->root);
+}
+
+char str_rope_char_at(const str_rope_t *rope, size_t index) {
+    if (index >= str_rope_len(rope->root)) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), 0);
+#else
+        return 0;
+#endif
+    }
+    const str_rope_node_t *node = rope->root;
+    for (;;) {
+        size_t lsize = str_rope_len(node->left);
+        if (index < lsize) {
+            node = node->left;
+        } else if (index < lsize + node->size) {
+            return node->data[index - lsize];
+        } else {
+            index -= lsize + node->size;
+            node = node->right;
+        }
+    }
+}
+
+// put middle between the first index bytes of rope and the rest
+static str_rope_t *str_rope_splice(str_rope_t *rope, size_t index, str_rope_node_t *middle) {
+    str_rope_node_t *left = NULL;
+    str_rope_node_t *right = NULL;
+    str_rope_node_t *head = NULL;
+    str_rope_node_t *root = NULL;
+    bool done = str_rope_split(rope->root, index, &left, &right) && str_rope_merge(left, middle, &head) && str_rope_merge(head, right, &root);
+    str_rope_release(left);
+    str_rope_release(right);
+    str_rope_release(head);
+    if (!done) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    str_rope_release(rope->root);
+    rope->root = root;
+    return rope;
+}
+
+str_rope_t *str_rope_insert_cstr(str_rope_t *rope, size_t index, const char *in) {
+    if (index > str_rope_len(rope->root)) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    size_t length = strlen(in);
+    str_rope_node_t *leaf = str_rope_leaf(rope, in, length);
+    if (leaf == NULL && length != 0) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    str_rope_t *result = str_rope_splice(rope, index, leaf);
+    str_rope_release(leaf);
+    return result;
+}
+
+str_rope_t *str_rope_insert(str_rope_t *rope, size_t index, const str_rope_t *in) {
+    if (index > str_rope_len(rope->root)) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    return str_rope_splice(rope, index, in->root);
+}
+
+str_rope_t *str_rope_append_cstr(str_rope_t *rope, const char *end) {
+    return str_rope_insert_cstr(rope, str_rope_len(rope->root), end);
+}
+
+str_rope_t *str_rope_append(str_rope_t *rope, const str_rope_t *end) {
+    return str_rope_splice(rope, str_rope_len(rope->root), end->root);
+}
+
+str_rope_t *str_rope_remove(str_rope_t *rope, size_t index, size_t length) {
+    if (index + length > str_rope_len(rope->root)) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    str_rope_node_t *head = NULL;
+    str_rope_node_t *rest = NULL;
+    str_rope_node_t *middle = NULL;
+    str_rope_node_t *tail = NULL;
+    str_rope_node_t *root = NULL;
+    bool done = str_rope_split(rope->root, index, &head, &rest) && str_rope_split(rest, length, &middle, &tail) && str_rope_merge(head, tail, &root);
+    str_rope_release(head);
+    str_rope_release(rest);
+    str_rope_release(middle);
+    str_rope_release(tail);
+    if (!done) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    str_rope_release(rope->root);
+    rope->root = root;
+    return rope;
+}
+
+str_rope_t *str_rope_substr(const str_rope_t *src, size_t start, size_t size) {
+    if (start + size > str_rope_len(src->root)) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bound\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    str_rope_t *rope = str_rope_alloc();
+    str_rope_node_t *head = NULL;
+    str_rope_node_t *rest = NULL;
+    str_rope_node_t *tail = NULL;
+    bool done = rope != NULL && str_rope_split(src->root, start, &head, &rest) && str_rope_split(rest, size, &rope->root, &tail);
+    str_rope_release(head);
+    str_rope_release(rest);
+    str_rope_release(tail);
+    if (!done) {
+        str_rope_free(rope);
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    return rope;
+}
+
+str_rope_t *str_rope_concated(const str_rope_t *start, const str_rope_t *end) {
+    str_rope_t *rope = str_rope_alloc();
+    if (rope == NULL || !str_rope_merge(start->root, end->root, &rope->root)) {
+        str_rope_free(rope);
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    return rope;
+}
+
+static char *str_rope_copy(const str_rope_node_t *node, char *dest) {
+    while (node != NULL) {
+        dest = str_rope_copy(node->left, dest);
+        memcpy(dest, node->data, node->size);
+        dest += node->size;
+        node = node->right;
+    }
+    return dest;
+}
+
+string_t *str_rope_flatten(const str_rope_t *rope) {
+    string_t *string = NULL;
+    if (str_resize(&string, str_rope_len(rope->root))) {
+        str_rope_copy(rope->root, string->cstr);
+        string->cstr[string->length] = 0;
+        return string;
+    }
+    return NULL;
+}
+
+// the text lives in buffer[0, start) and buffer[end, capacity), the gap in
+// between sits where the last edit happened
+struct str_gap_t {
+    char *buffer;
+    size_t start;
+    size_t end;
+    size_t capacity;
+    const str_allocator_t *allocator;
+};
+
+// move the gap so it starts at index, and make it at least size bytes wide
+static bool str_gap_prepare(str_gap_t *gap, size_t index, size_t size) {
+    size_t after = gap->capacity - gap->end;
+    if (gap->buffer == NULL || gap->end - gap->start < size) {
+        size_t length = gap->start + after;
+        // always doubles whatever the growth policy is, the gap has to stay
+        // wide for inserts to be cheap
+        size_t capacity = str_grow_2x(gap->capacity, length + size);
+        char *buffer = str_raw_alloc(gap->allocator, capacity);
+        if (buffer == NULL) {
+            return false;
+        }
+        if (gap->buffer != NULL) {
+            memcpy(buffer, gap->buffer, gap->start);
+            memcpy(buffer + capacity - after, gap->buffer + gap->end, after);
+            str_raw_free(gap->allocator, gap->buffer);
+        }
+        gap->buffer = buffer;
+        gap->end = capacity - after;
+        gap->capacity = capacity;
+    }
+    if (index < gap->start) {
+        size_t size = gap->start - index;
+        memmove(gap->buffer + gap->end - size, gap->buffer + index, size);
+        gap->start -= size;
+        gap->end -= size;
+    } else if (index > gap->start) {
+        size_t size = index - gap->start;
+        memmove(gap->buffer + gap->start, gap->buffer + gap->end, size);
+        gap->start += size;
+        gap->end += size;
+    }
+    return true;
+}
+
+static str_gap_t *str_gap_new_view(const char *src, size_t length) {
+    const str_allocator_t *allocator = str_get_allocator();
+    str_gap_t *gap = str_raw_alloc(allocator, sizeof(str_gap_t));
+    if (gap == NULL) {
+        goto oom;
+    }
+    gap->buffer = NULL;
+    gap->start = 0;
+    gap->end = 0;
+    gap->capacity = 0;
+    gap->allocator = allocator;
+    if (!str_gap_prepare(gap, 0, length)) {
+        str_gap_free(gap);
+        goto oom;
+    }
+    memcpy(gap->buffer, src, length);
+    gap->start = length;
+    return gap;
+oom:
+#ifdef YASLI_DEBUG
+    return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+    return NULL;
+#endif
+}
+
+str_gap_t *str_gap_new(const char *src) {
+    return str_gap_new_view(src, strlen(src));
+}
+
+str_gap_t *str_gap_from_string(const string_t *src) {
+    return str_gap_new_view(src->cstr, src->length);
+}
+
+void str_gap_free(str_gap_t *gap) {
+    if (gap != NULL) {
+        if (gap->buffer != NULL) {
+            str_raw_free(gap->allocator, gap->buffer);
+        }
+        str_raw_free(gap->allocator, gap);
+    }
+}
+
+size_t str_gap_length(const str_gap_t *gap) {
+    return gap->capacity - (gap->end - gap->start);
+}
+
+char str_gap_char_at(const str_gap_t *gap, size_t index) {
+    if (index >= str_gap_length(gap)) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), 0);
+#else
+        return 0;
+#endif
+    }
+    return index < gap->start ? gap->buffer[index] : gap->buffer[index + gap->end - gap->start];
+}
+
+static str_gap_t *str_gap_insert_view(str_gap_t *gap, size_t index, const char *in, size_t length) {
+    if (index > str_gap_length(gap)) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    if (!str_gap_prepare(gap, index, length)) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    memcpy(gap->buffer + gap->start, in, length);
+    gap->start += length;
+    return gap;
+}
+
+str_gap_t *str_gap_insert_cstr(str_gap_t *gap, size_t index, const char *in) {
+    return str_gap_insert_view(gap, index, in, strlen(in));
+}
+
+str_gap_t *str_gap_insert(str_gap_t *gap, size_t index, const string_t *in) {
+    return str_gap_insert_view(gap, index, in->cstr, in->length);
+}
+
+str_gap_t *str_gap_remove(str_gap_t *gap, size_t index, size_t length) {
+    if (index + length > str_gap_length(gap)) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    // moving the gap never fails when it does not need to grow
+    str_gap_prepare(gap, index, 0);
+    gap->end += length;
+    return gap;
+}
+
+string_t *str_gap_flatten(const str_gap_t *gap) {
+    string_t *string = NULL;
+    if (str_resize(&string, str_gap_length(gap))) {
+        memcpy(string->cstr, gap->buffer, gap->start);
+        memcpy(string->cstr + gap->start, gap->buffer + gap->end, gap->capacity - gap->end);
+        string->cstr[string->length] = 0;
+        return string;
+    }
+    return NULL;
+}
+
+typedef struct str_builder_chunk_t {
+    struct str_builder_chunk_t *next;
+    size_t size;
+    size_t used;
+    char data[];
+} str_builder_chunk_t;
+
+// appends go to the last chunk, a full chunk is never copied or moved
+struct str_builder_t {
+    str_builder_chunk_t *head;
+    str_builder_chunk_t *tail;
+    size_t length;
+    const str_allocator_t *allocator;
+};
+
+// chunks double in size up to this, bigger pieces get a chunk of their own size
+#define STR_BUILDER_CHUNK ((size_t)1 << 20)
+
+str_builder_t *str_builder_new(void) {
+    const str_allocator_t *allocator = str_get_allocator();
+    str_builder_t *builder = str_raw_alloc(allocator, sizeof(str_builder_t));
+    if (builder == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    builder->head = NULL;
+    builder->tail = NULL;
+    builder->length = 0;
+    builder->allocator = allocator;
+    return builder;
+}
+
+void str_builder_free(str_builder_t *builder) {
+    if (builder == NULL) {
+        return;
+    }
+    for (str_builder_chunk_t *chunk = builder->head; chunk != NULL;) {
+        str_builder_chunk_t *next = chunk->next;
+        str_raw_free(builder->allocator, chunk);
+        chunk = next;
+    }
+    str_raw_free(builder->allocator, builder);
+}
+
+void str_builder_clear(str_builder_t *builder) {
+    // keep the last chunk, it is the biggest
+    for (str_builder_chunk_t *chunk = builder->head; chunk != builder->tail;) {
+        str_builder_chunk_t *next = chunk->next;
+        str_raw_free(builder->allocator, chunk);
+        chunk = next;
+    }
+    builder->head = builder->tail;
+    if (builder->tail != NULL) {
+        builder->tail->used = 0;
+    }
+    builder->length = 0;
+}
+
+size_t str_builder_length(const str_builder_t *builder) {
+    return builder->length;
+}
+
+// room for at least size more bytes at the end of the last chunk
+static char *str_builder_room(str_builder_t *builder, size_t size) {
+    str_builder_chunk_t *tail = builder->tail;
+    if (tail != NULL && tail->size - tail->used >= size) {
+        return tail->data + tail->used;
+    }
+    size_t chunk_size = tail == NULL ? 256 : tail->size < STR_BUILDER_CHUNK ? tail->size * 2 : STR_BUILDER_CHUNK;
+    if (chunk_size < size) {
+        chunk_size = size;
+    }
+    str_builder_chunk_t *chunk = str_raw_alloc(builder->allocator, sizeof(str_builder_chunk_t) + chunk_size);
+    if (chunk == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    chunk->next = NULL;
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    if (tail != NULL && tail->used == 0) {
+        // an empty chunk that is too small is dropped instead of kept around
+        str_builder_chunk_t **link = &builder->head;
+        while (*link != tail) {
+            link = &(*link)->next;
+        }
+        *link = chunk;
+        str_raw_free(builder->allocator, tail);
+    } else if (tail != NULL) {
+        tail->next = chunk;
+    } else {
+        builder->head = chunk;
+    }
+    builder->tail = chunk;
+    return chunk->data;
+}
+
+static str_builder_t *str_builder_append_view(str_builder_t *builder, const char *src, size_t length) {
+    char *dest = str_builder_room(builder, length);
+    if (dest == NULL) {
+        return NULL;
+    }
+    memcpy(dest, src, length);
+    builder->tail->used += length;
+    builder->length += length;
+    return builder;
+}
+
+str_builder_t *str_builder_append(str_builder_t *builder, const string_t *src) {
+    return str_builder_append_view(builder, src->cstr, src->length);
+}
+
+str_builder_t *str_builder_append_cstr(str_builder_t *builder, const char *src) {
+    return str_builder_append_view(builder, src, strlen(src));
+}
+
+str_builder_t *str_builder_append_char(str_builder_t *builder, char c) {
+    return str_builder_append_view(builder, &c, 1);
+}
+
+str_builder_t *str_builder_append_format(str_builder_t *builder, const char *format, ...) {
+    va_list ap, _ap;
+    va_start(ap, format);
+    va_copy(_ap, ap);
+    // try to print into what is left of the last chunk first
+    str_builder_chunk_t *tail = builder->tail;
+    size_t room = tail != NULL ? tail->size - tail->used : 0;
+    // a full chunk gets no buffer at all, stb terminates at buf[-1] for a count of 0
+    int size = vsnprintf(room != 0 ? tail->data + tail->used : NULL, room, format, ap);
+    va_end(ap);
+    if (size < 0) {
+        va_end(_ap);
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: invalid format\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    if ((size_t)size >= room) {
+        // vsnprintf needs room for the null terminator as well
+        char *dest = str_builder_room(builder, size + 1);
+        if (dest == NULL) {
+            va_end(_ap);
+            return NULL;
+        }
+        vsnprintf(dest, size + 1, format, _ap);
+    }
+    va_end(_ap);
+    builder->tail->used += size;
+    builder->length += size;
+    return builder;
+}
+
+string_t *str_builder_build(const str_builder_t *builder) {
+    string_t *string = str_mem_alloc(STR_HEADER + sizeof(char) * (builder->length + 1));
+    if (string == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    string->length = builder->length;
+    string->capacity = builder->length + 1;
+    char *dest = string->cstr;
+    for (const str_builder_chunk_t *chunk = builder->head; chunk != NULL; chunk = chunk->next) {
+        memcpy(dest, chunk->data, chunk->used);
+        dest += chunk->used;
+    }
+    *dest = 0;
+    return string;
+}
+
+// one block with the entries followed by the bytes they point to, every entry
+// is null terminated inside the blob. the entries end with a view whose data
+// is NULL
+struct str_table_t {
+    size_t count;
+    str_view_t entries[];
+};
+
+// allocate a table for count entries and size bytes of text, terminators
+// included. the returned pointer is where the text goes
+static char *str_table_alloc(str_table_t **table, size_t count, size_t size) {
+    *table = str_mem_alloc(sizeof(str_table_t) + sizeof(str_view_t) * (count + 1) + size);
+    if (*table == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    (*table)->count = count;
+    (*table)->entries[count] = (str_view_t){NULL, 0};
+    return (char *)((*table)->entries + count + 1);
+}
+
+str_table_t *str_split_table(const string_t *src, const char *needle) {
+    size_t nlen = strlen(needle);
+    const char *end = src->cstr + src->length;
+    size_t count = 1;
+    if (nlen != 0) {
+        for (const char *token = str_memmem(src->cstr, src->length, needle, nlen); token != NULL; token = str_memmem(token + nlen, end - token - nlen, needle, nlen)) {
+            count++;
+        }
+    }
+    str_table_t *table;
+    char *blob = str_table_alloc(&table, count, src->length - (count - 1) * nlen + count);
+    if (blob == NULL) {
+        return NULL;
+    }
+    const char *str = src->cstr;
+    for (size_t index = 0; index < count; index++) {
+        const char *token = index + 1 < count ? str_memmem(str, end - str, needle, nlen) : end;
+        size_t length = token - str;
+        memcpy(blob, str, length);
+        blob[length] = 0;
+        table->entries[index] = (str_view_t){blob, length};
+        blob += length + 1;
+        str = token + nlen;
+    }
+    return table;
+}
+
+str_table_t *str_table_new_arr(const char **src) {
+    size_t count = 0;
+    size_t size = 0;
+    for (; src[count] != NULL; count++) {
+        size += strlen(src[count]) + 1;
+    }
+    str_table_t *table;
+    char *blob = str_table_alloc(&table, count, size);
+    if (blob == NULL) {
+        return NULL;
+    }
+    for (size_t index = 0; index < count; index++) {
+        size_t length = strlen(src[index]);
+        memcpy(blob, src[index], length + 1);
+        table->entries[index] = (str_view_t){blob, length};
+        blob += length + 1;
+    }
+    return table;
+}
+
+size_t str_table_count(const str_table_t *table) {
+    return table->count;
+}
+
+str_view_t str_table_at(const str_table_t *table, size_t index) {
+    if (index >= table->count) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bounds\n", stderr), (str_view_t){NULL, 0});
+#else
+        return (str_view_t){NULL, 0};
+#endif
+    }
+    return table->entries[index];
+}
+
+// built in compare functions for str_table_sort
+static int str_table_cmp_l(const void *arg1, const void *arg2) {
+    const str_view_t *str1 = arg1;
+    const str_view_t *str2 = arg2;
+    return (str1->length > str2->length) - (str1->length < str2->length);
+}
+static int str_table_cmp_a(const void *arg1, const void *arg2) {
+    return str_view_strcmp(*(const str_view_t *)arg1, *(const str_view_t *)arg2);
+}
+static int str_table_cmp_ai(const void *arg1, const void *arg2) {
+    const str_view_t *str1 = arg1;
+    const str_view_t *str2 = arg2;
+    size_t length = str1->length < str2->length ? str1->length : str2->length;
+    for (size_t i = 0; i < length; i++) {
+        int diff = toupper((unsigned char)str1->data[i]) - toupper((unsigned char)str2->data[i]);
+        if (diff != 0) {
+            return diff;
+        }
+    }
+    return (str1->length > str2->length) - (str1->length < str2->length);
+}
+static int str_table_cmp_la(const void *arg1, const void *arg2) {
+    int diff = str_table_cmp_l(arg1, arg2);
+    return diff != 0 ? diff : str_table_cmp_a(arg1, arg2);
+}
+static int str_table_cmp_lai(const void *arg1, const void *arg2) {
+    int diff = str_table_cmp_l(arg1, arg2);
+    return diff != 0 ? diff : str_table_cmp_ai(arg1, arg2);
+}
+
+str_table_t *str_table_sort(str_table_t *table, const char *mode, ...) {
+    int order = str_sort_mode(mode);
+    if (order == STR_SORT_INVALID) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: invalid mode\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+#ifdef _MSC_VER
+    void *temp;
+#endif
+    static int (*const compars[])(const void *, const void *) = {NULL, str_table_cmp_l, str_table_cmp_a, str_table_cmp_ai, str_table_cmp_la, str_table_cmp_lai};
+    int (*compar)(const void *, const void *) = compars[order];
+    if (order == STR_SORT_C) {
+        va_list ap;
+        va_start(ap, mode);
+#ifdef _MSC_VER
+        temp = va_arg(ap, void *);
+        compar = (int (*)(const void *, const void *))temp;
+#else
+        compar = va_arg(ap, int (*)(const void *, const void *));
+#endif
+        va_end(ap);
+    }
+    // only the entries move, the text stays where it is
+    qsort(table->entries, table->count, sizeof(str_view_t), compar);
+    return table;
+}
+
+string_t *str_table_join(const str_table_t *table, const char *sep) {
+    size_t slen = strlen(sep);
+    size_t length = table->count != 0 ? (table->count - 1) * slen : 0;
+    for (size_t index = 0; index < table->count; index++) {
+        length += table->entries[index].length;
+    }
+    string_t *string = NULL;
+    if (!str_resize(&string, length)) {
+        return NULL;
+    }
+    char *dest = string->cstr;
+    for (size_t index = 0; index < table->count; index++) {
+        if (index != 0) {
+            memcpy(dest, sep, slen);
+            dest += slen;
+        }
+        memcpy(dest, table->entries[index].data, table->entries[index].length);
+        dest += table->entries[index].length;
+    }
+    *dest = 0;
+    return string;
+}
+
+// rough frequency of a byte in text, higher is more common. the searcher uses
+// it to pick the two rarest bytes of a needle for its prefilter
+static inline int str_byte_rank(unsigned char c) {
+    // lower case letters and space from the rarest to the most common
+    static const char letters[] = "zqxjkvbpygfwmucldrhsnioate ";
+    const char *letter = c != 0 ? strchr(letters, c) : NULL;
+    if (letter != NULL) {
+        return 8 + (int)(letter - letters);
+    }
+    // plain ascii ranges, so the choice does not depend on the locale
+    bool upper = c >= 'A' && c <= 'Z';
+    if ((c > ' ' && c < 0x7f && !upper && !(c >= 'a' && c <= 'z')) || c == '\n') {
+        // digits and punctuation
+        return 6;
+    }
+    if (upper || c == '\t' || c == '\r') {
+        return 4;
+    }
+    // bytes of multibyte characters and control characters
+    return c >= 0x80 ? 2 : 0;
+}
+
+struct str_searcher_t {
+    size_t length;
+    // offsets of the two rarest bytes of needle, rare1 < rare2
+    size_t rare1;
+    size_t rare2;
+    // horspool shifts, indexed by the haystack byte under the last needle byte
+    size_t shift[256];
+    const str_allocator_t *allocator;
+    char needle[];
+};
+
+str_searcher_t *str_searcher_new(const char *needle) {
+    size_t length = strlen(needle);
+    const str_allocator_t *allocator = str_get_allocator();
+    str_searcher_t *searcher = str_raw_alloc(allocator, sizeof(str_searcher_t) + length + 1);
+    if (searcher == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    searcher->length = length;
+    searcher->allocator = allocator;
+    memcpy(searcher->needle, needle, length + 1);
+
+    size_t rare1 = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (str_byte_rank((unsigned char)needle[i]) < str_byte_rank((unsigned char)needle[rare1])) {
+            rare1 = i;
+        }
+    }
+    // the second one is the rarest of the others, preferring a byte that
+    // differs from the first so the two compares tell different things
+    size_t rare2 = rare1;
+    int best = INT_MAX;
+    for (size_t i = 0; i < length; i++) {
+        int rank = str_byte_rank((unsigned char)needle[i]) + (needle[i] == needle[rare1] ? 64 : 0);
+        if (i != rare1 && rank < best) {
+            rare2 = i;
+            best = rank;
+        }
+    }
+    searcher->rare1 = rare1 < rare2 ? rare1 : rare2;
+    searcher->rare2 = rare1 < rare2 ? rare2 : rare1;
+
+    for (size_t i = 0; i < 256; i++) {
+        searcher->shift[i] = length;
+    }
+    for (size_t i = 0; i + 1 < length; i++) {
+        searcher->shift[(unsigned char)needle[i]] = length - 1 - i;
+    }
+    return searcher;
+}
+
+void str_searcher_free(str_searcher_t *searcher) {
+    if (searcher != NULL) {
+        str_raw_free(searcher->allocator, searcher);
+    }
+}
+
+int64_t str_searcher_find(const str_searcher_t *searcher, str_view_t src) {
+    size_t length = searcher->length;
+    const char *needle = searcher->needle;
+    if (length == 0) {
+        return 0;
+    }
+    if (length > src.length) {
+        return -1;
+    }
+    if (length == 1) {
+        const char *ptr = memchr(src.data, needle[0], src.length);
+        return ptr != NULL ? (int64_t)(ptr - src.data) : -1;
+    }
+    size_t last = src.length - length;
+    size_t offset1 = searcher->rare1;
+    size_t i = 0;
+    // only the vector loops filter on the second rare byte
+#if defined(STR_AVX2)
+    size_t offset2 = searcher->rare2;
+    while (i + offset2 + 32 <= src.length) {
+        // set up again after every memcmp, so the constants are not spilled
+        // across the call for the whole loop
+        const __m256i rare1 = _mm256_set1_epi8(needle[offset1]);
+        const __m256i rare2 = _mm256_set1_epi8(needle[offset2]);
+        uint32_t mask = 0;
+        for (; i + offset2 + 32 <= src.length; i += 32) {
+            __m256i block1 = _mm256_loadu_si256((const __m256i *)(src.data + i + offset1));
+            __m256i block2 = _mm256_loadu_si256((const __m256i *)(src.data + i + offset2));
+            mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block1, rare1), _mm256_cmpeq_epi8(block2, rare2)));
+            if (mask != 0) {
+                break;
+            }
+        }
+        if (mask == 0) {
+            break;
+        }
+        for (; mask != 0; mask &= mask - 1) {
+            size_t index = i + str_ctz(mask);
+            // the ends are checked inline, most false candidates stop there
+            if (index <= last && src.data[index] == needle[0] && src.data[index + length - 1] == needle[length - 1] && memcmp(src.data + index, needle, length) == 0) {
+                return (int64_t)index;
+            }
+        }
+        i += 32;
+    }
+#elif defined(STR_SSE2)
+    size_t offset2 = searcher->rare2;
+    while (i + offset2 + 16 <= src.length) {
+        // set up again after every memcmp, so the constants are not spilled
+        // across the call for the whole loop
+        const __m128i rare1 = _mm_set1_epi8(needle[offset1]);
+        const __m128i rare2 = _mm_set1_epi8(needle[offset2]);
+        uint32_t mask = 0;
+        for (; i + offset2 + 16 <= src.length; i += 16) {
+            __m128i block1 = _mm_loadu_si128((const __m128i *)(src.data + i + offset1));
+            __m128i block2 = _mm_loadu_si128((const __m128i *)(src.data + i + offset2));
+            mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block1, rare1), _mm_cmpeq_epi8(block2, rare2)));
+            if (mask != 0) {
+                break;
+            }
+        }
+        if (mask == 0) {
+            break;
+        }
+        for (; mask != 0; mask &= mask - 1) {
+            size_t index = i + str_ctz(mask);
+            // the ends are checked inline, most false candidates stop there
+            if (index <= last && src.data[index] == needle[0] && src.data[index + length - 1] == needle[length - 1] && memcmp(src.data + index, needle, length) == 0) {
+                return (int64_t)index;
+            }
+        }
+        i += 16;
+    }
+#endif  // STR_AVX2
+    // memchr on the rarest byte is a good filter while that byte stays rare in
+    // the haystack, once it shows up too often horspool takes over
+    for (size_t candidates = 0; i <= last && (candidates < 8 || candidates * 32 < i);) {
+        const char *ptr = memchr(src.data + i + offset1, needle[offset1], last - i + 1);
+        if (ptr == NULL) {
+            return -1;
+        }
+        i = ptr - src.data - offset1;
+        if (src.data[i] == needle[0] && src.data[i + length - 1] == needle[length - 1] && memcmp(src.data + i, needle, length) == 0) {
+            return (int64_t)i;
+        }
+        i++;
+        candidates++;
+    }
+    while (i <= last) {
+        unsigned char c = src.data[i + length - 1];
+        if (c == (unsigned char)needle[length - 1] && src.data[i + offset1] == needle[offset1] && memcmp(src.data + i, needle, length - 1) == 0) {
+            return (int64_t)i;
+        }
+        i += searcher->shift[c];
+    }
+    return -1;
+}
+
+bool str_searcher_has(const str_searcher_t *searcher, str_view_t src) {
+    return str_searcher_find(searcher, src) >= 0;
+}
+
+typedef struct str_multi_state_t {
+    // length of the longest suffix of the text read so far that is a prefix of
+    // some pattern, which is what the state stands for
+    uint32_t depth;
+    // the longest pattern that ends here and its index, length 0 for none
+    uint32_t match_length;
+    uint32_t match_id;
+} str_multi_state_t;
+
+// aho-corasick automaton with every transition filled in, so the scan never
+// follows failure links. bytes that appear in no pattern share class 0, which
+// keeps the table narrow. a transition holds the row of the next state, that
+// is its number times class_count, and states where a pattern ends are
+// numbered last, so the scan needs no multiply and finds a match with one
+// compare
+struct str_multi_t {
+    size_t count;
+    size_t state_count;
+    size_t class_count;
+    // first row of a state where a pattern ends
+    uint32_t match_row;
+    const str_allocator_t *allocator;
+    uint32_t *delta;
+    str_multi_state_t *states;
+    uint8_t classes[256];
+};
+
+str_multi_t *str_multi_new(const char **patterns) {
+    size_t count = 0;
+    size_t total = 0;
+    bool used[256] = {0};
+    for (; patterns[count] != NULL; count++) {
+        for (const char *ch = patterns[count]; *ch != 0; ch++) {
+            used[(unsigned char)*ch] = true;
+            total++;
+        }
+    }
+    size_t class_count = 1;
+    uint8_t classes[256];
+    for (size_t i = 0; i < 256; i++) {
+        classes[i] = used[i] ? (uint8_t)class_count++ : 0;
+    }
+    // at most one state per pattern byte plus the root
+    size_t max_states = total + 1;
+    if (max_states > UINT32_MAX / class_count) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: patterns too long\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+
+    // the automaton is built in scratch memory, then copied renumbered
+    const str_allocator_t *allocator = str_get_allocator();
+    uint32_t *trie = str_raw_alloc(allocator, sizeof(uint32_t) * max_states * (class_count + 3) + sizeof(str_multi_state_t) * max_states);
+    if (trie == NULL) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    uint32_t *fail = trie + max_states * class_count;
+    uint32_t *queue = fail + max_states;
+    uint32_t *order = queue + max_states;
+    str_multi_state_t *states = (str_multi_state_t *)(order + max_states);
+    memset(trie, 0, sizeof(uint32_t) * max_states * class_count);
+    memset(states, 0, sizeof(str_multi_state_t) * max_states);
+
+    // the trie, 0 stands for a missing child since the root is nobody's child
+    size_t state_count = 1;
+    for (size_t id = 0; id < count; id++) {
+        uint32_t state = 0;
+        uint32_t depth = 0;
+        for (const char *ch = patterns[id]; *ch != 0; ch++) {
+            uint32_t *next = &trie[state * class_count + classes[(unsigned char)*ch]];
+            if (*next == 0) {
+                *next = (uint32_t)state_count++;
+                states[*next].depth = depth + 1;
+            }
+            state = *next;
+            depth++;
+        }
+        // empty patterns are ignored, the first of duplicated patterns wins
+        if (depth != 0 && states[state].match_length == 0) {
+            states[state].match_length = depth;
+            states[state].match_id = (uint32_t)id;
+        }
+    }
+
+    // breadth first, so the failure state of a state is complete before it
+    size_t head = 0;
+    size_t tail = 0;
+    queue[tail++] = 0;
+    fail[0] = 0;
+    while (head < tail) {
+        uint32_t state = queue[head++];
+        for (size_t c = 0; c < class_count; c++) {
+            uint32_t *next = &trie[state * class_count + c];
+            if (*next != 0 && c != 0) {
+                fail[*next] = state == 0 ? 0 : trie[fail[state] * class_count + c];
+                if (states[*next].match_length == 0) {
+                    states[*next].match_length = states[fail[*next]].match_length;
+                    states[*next].match_id = states[fail[*next]].match_id;
+                }
+                queue[tail++] = *next;
+            } else {
+                *next = state == 0 ? 0 : trie[fail[state] * class_count + c];
+            }
+        }
+    }
+
+    // states without a match first, the root stays 0
+    uint32_t number = 0;
+    for (size_t state = 0; state < state_count; state++) {
+        if (states[state].match_length == 0) {
+            order[state] = number++;
+        }
+    }
+    uint32_t match_state = number;
+    for (size_t state = 0; state < state_count; state++) {
+        if (states[state].match_length != 0) {
+            order[state] = number++;
+        }
+    }
+
+    str_multi_t *multi = str_raw_alloc(allocator, sizeof(str_multi_t) + sizeof(uint32_t) * state_count * class_count + sizeof(str_multi_state_t) * state_count);
+    if (multi == NULL) {
+        str_raw_free(allocator, trie);
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+        return NULL;
+#endif
+    }
+    multi->count = count;
+    multi->state_count = state_count;
+    multi->class_count = class_count;
+    multi->match_row = (uint32_t)(match_state * class_count);
+    multi->allocator = allocator;
+    multi->delta = (uint32_t *)(multi + 1);
+    multi->states = (str_multi_state_t *)(multi->delta + state_count * class_count);
+    memcpy(multi->classes, classes, sizeof(classes));
+    for (size_t state = 0; state < state_count; state++) {
+        uint32_t *row = &multi->delta[order[state] * class_count];
+        for (size_t c = 0; c < class_count; c++) {
+            row[c] = (uint32_t)(order[trie[state * class_count + c]] * class_count);
+        }
+        multi->states[order[state]] = states[state];
+    }
+    str_raw_free(allocator, trie);
+    return multi;
+}
+
+void str_multi_free(str_multi_t *multi) {
+    if (multi != NULL) {
+        str_raw_free(multi->allocator, multi);
+    }
+}
+
+// leftmost match at or after start, and among the matches starting there the
+// longest one. returns the index, or -1 if there is none
+static int64_t str_multi_next(const str_multi_t *multi, const char *src, size_t length, size_t start, size_t *id, size_t *size) {
+    const uint32_t *delta = multi->delta;
+    const uint8_t *classes = multi->classes;
+    uint32_t match_row = multi->match_row;
+    uint32_t row = 0;
+    size_t pos = start;
+    // nothing matched yet, so only a match has to be looked for
+    for (; pos < length; pos++) {
+        row = delta[row + classes[(unsigned char)src[pos]]];
+        if (row >= match_row) {
+            break;
+        }
+    }
+    if (pos == length) {
+        return -1;
+    }
+    const str_multi_state_t *state = &multi->states[row / multi->class_count];
+    size_t best = pos + 1 - state->match_length;
+    *id = state->match_id;
+    *size = state->match_length;
+    // a longer match may still start at or before best, keep going while the
+    // state reaches back that far
+    for (pos++; pos < length; pos++) {
+        row = delta[row + classes[(unsigned char)src[pos]]];
+        state = &multi->states[row / multi->class_count];
+        if (pos + 1 - state->depth > best) {
+            break;
+        }
+        if (state->match_length != 0 && pos + 1 - state->match_length <= best) {
+            best = pos + 1 - state->match_length;
+            *id = state->match_id;
+            *size = state->match_length;
+        }
+    }
+    return (int64_t)best;
+}
+
+int64_t str_find_any(const str_multi_t *multi, const string_t *src, size_t start, size_t *which) {
+    if (start > src->length) {
+#ifdef YASLI_DEBUG
+        return (fputs("[ERRO]: index out of bound\n", stderr), -1);
 #else
-            return NULL;
+        return -1;
 #endif
-        } else if ((*str & 0x80) == 0) {
-            str++;
-            info[current_char] = 1;
-            if (step > 0) {
-                if (current_char % abs_step == 0) {
-                    total_size += 1;
+    }
+    size_t id;
+    size_t size;
+    int64_t index = str_multi_next(multi, src->cstr, src->length, start, &id, &size);
+    if (index >= 0 && which != NULL) {
+        *which = id;
+    }
+    return index;
+}
+
+typedef struct str_match_t {
+    size_t index;
+    size_t size;
+    size_t id;
+} str_match_t;
+
+string_t *str_replaced_any(const str_multi_t *multi, const string_t *src, const char **new_vals) {
+    // matches are kept so the text is scanned once and the result allocated once
+    size_t cap = 64;
+    size_t count = 0;
+    str_match_t *matches = str_raw_alloc(multi->allocator, sizeof(str_match_t) * cap);
+    if (matches == NULL) {
+        goto oom;
+    }
+    size_t length = src->length;
+    size_t id;
+    size_t size;
+    for (int64_t index = 0; (index = str_multi_next(multi, src->cstr, src->length, index, &id, &size)) >= 0; index += size) {
+        if (count == cap) {
+            str_match_t *temp = str_raw_alloc(multi->allocator, sizeof(str_match_t) * cap * 2);
+            if (temp == NULL) {
+                str_raw_free(multi->allocator, matches);
+                goto oom;
+            }
+            memcpy(temp, matches, sizeof(str_match_t) * count);
+            str_raw_free(multi->allocator, matches);
+            matches = temp;
+            cap *= 2;
+        }
+        matches[count++] = (str_match_t){(size_t)index, size, id};
+        length = length - size + strlen(new_vals[id]);
+    }
+    string_t *result = NULL;
+    if (!str_resize(&result, length)) {
+        str_raw_free(multi->allocator, matches);
+        return NULL;
+    }
+    char *dest = result->cstr;
+    size_t prev = 0;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(dest, src->cstr + prev, matches[i].index - prev);
+        dest += matches[i].index - prev;
+        size_t new_len = strlen(new_vals[matches[i].id]);
+        memcpy(dest, new_vals[matches[i].id], new_len);
+        dest += new_len;
+        prev = matches[i].index + matches[i].size;
+    }
+    memcpy(dest, src->cstr + prev, src->length - prev);
+    result->cstr[length] = 0;
+    str_raw_free(multi->allocator, matches);
+    return result;
+oom:
+#ifdef YASLI_DEBUG
+    return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
+    return NULL;
+#endif
+}
+
+// a regular expression is parsed into a tree and compiled into a thompson nfa
+// twice, forward and reversed. searches run a dfa whose states are sets of nfa
+// states, built lazily as the text needs them and kept in a bounded cache.
+// matches are leftmost longest: the forward pass finds where the match ends,
+// the reversed one runs back from there to find where it starts. ^ and $ are
+// zero width assertions on the position in the text, a thread that waits for
+// the end of the text stays in the state until the run gets there
+
+#define STR_REGEX_MAX_INSTS 65536
+#define STR_REGEX_MAX_REPEAT 1000
+#define STR_REGEX_MAX_DEPTH 1000
+#define STR_REGEX_STATES 512
+#define STR_REGEX_PREFIX 32
+#define STR_RE_NONE UINT32_MAX
+
+enum { STR_RE_EMPTY, STR_RE_SET, STR_RE_CAT, STR_RE_ALT, STR_RE_REPEAT, STR_RE_ANCHOR };
+
+// the anchor of a STR_RE_ANCHOR node
+enum { STR_RE_TEXT_BEGIN, STR_RE_TEXT_END };
+
+typedef struct str_re_node_t {
+    uint8_t type;
+    int32_t min;
+    int32_t max;     // -1 for unbounded
+    uint32_t set;    // STR_RE_SET, the anchor of STR_RE_ANCHOR
+    uint32_t first;  // children of STR_RE_CAT and STR_RE_ALT, the child of STR_RE_REPEAT
+    uint32_t last;
+    uint32_t prev;  // siblings
+    uint32_t next;
+} str_re_node_t;
+
+typedef struct str_re_set_t {
+    uint64_t bits[4];
+} str_re_set_t;
+
+enum { STR_RE_BYTE, STR_RE_SPLIT, STR_RE_MATCH, STR_RE_ASSERT };
+
+// the position a STR_RE_ASSERT holds at, kept in its set. ^ holds where a
+// forward run starts at the beginning of the text and where a reversed run
+// ends there, $ the other way around
+#define STR_RE_AT_FIRST 1u
+#define STR_RE_AT_LAST 2u
+
+typedef struct str_re_inst_t {
+    uint8_t op;
+    uint32_t set;
+    uint32_t out;
+    uint32_t out1;
+} str_re_inst_t;
+
+// flags of a dfa state
+#define STR_RE_ANCHORED 1u  // no new threads are started
+#define STR_RE_MATCHED 2u   // a match was seen, no new threads are started
+#define STR_RE_IS_MATCH 4u  // a match ends here
+#define STR_RE_DEAD 8u      // no thread is left
+#define STR_RE_WAITING 16u  // a thread waits for the last position
+// separates the threads started at different positions in a state
+#define STR_RE_SEP UINT32_MAX
+
+typedef struct str_re_dstate_t {
+    uint32_t list;
+    uint32_t length;
+    uint32_t flags;
+} str_re_dstate_t;
+
+typedef struct str_re_prog_t {
+    str_re_inst_t *insts;
+    uint32_t inst_count;
+    uint32_t inst_cap;
+    uint32_t start;
+    // dfa cache, transitions are -1 until computed
+    str_re_dstate_t *states;
+    uint32_t state_count;
+    int32_t *trans;
+    uint32_t *lists;
+    uint32_t list_used;
+    uint32_t list_cap;
+    uint32_t *table;  // open addressing, state + 1 and 0 for empty
+    // scratch for building states
+    uint32_t *buffers[2];
+    uint32_t *stack;
+    uint32_t *marks;
+    uint32_t mark;
+} str_re_prog_t;
+
+struct str_regex_t {
+    str_re_prog_t forward;
+    str_re_prog_t reverse;
+    str_re_set_t *sets;
+    uint32_t set_count;
+    uint32_t class_count;
+    uint32_t stride;  // row length of the transition tables, even so rows leave the low bit free
+    uint8_t classes[256];
+    bool anchor_start;  // every match starts at the beginning of the text
+    bool anchor_end;    // every match ends at the end of the text
+    size_t prefix_length;
+    char prefix[STR_REGEX_PREFIX];
+    const str_allocator_t *allocator;
+};
+
+typedef struct str_re_parser_t {
+    const char *ptr;
+    const char *end;
+    str_re_node_t *nodes;
+    uint32_t node_count;
+    uint32_t node_cap;
+    str_re_set_t *sets;
+    uint32_t set_count;
+    uint32_t set_cap;
+    uint32_t depth;
+    const char *error;
+    const str_allocator_t *allocator;
+} str_re_parser_t;
+
+// make room for one more element in array, returns the array, or NULL
+static void *str_re_grow(const str_allocator_t *allocator, void *array, uint32_t *cap, uint32_t count, size_t size) {
+    if (count < *cap) {
+        return array;
+    }
+    uint32_t new_cap = *cap != 0 ? *cap * 2 : 16;
+    void *temp = str_raw_alloc(allocator, size * new_cap);
+    if (temp == NULL) {
+        return NULL;
+    }
+    if (array != NULL) {
+        memcpy(temp, array, size * count);
+        str_raw_free(allocator, array);
+    }
+    *cap = new_cap;
+    return temp;
+}
+
+static inline bool str_re_set_has(const str_re_set_t *set, unsigned char byte) {
+    return (set->bits[byte >> 6] >> (byte & 63)) & 1;
+}
+
+static inline void str_re_set_range(str_re_set_t *set, unsigned char lo, unsigned char hi) {
+    for (unsigned i = lo; i <= hi; i++) {
+        set->bits[i >> 6] |= 1ull << (i & 63);
+    }
+}
+
+static inline void str_re_set_invert(str_re_set_t *set) {
+    for (size_t i = 0; i < 4; i++) {
+        set->bits[i] = ~set->bits[i];
+    }
+}
+
+static uint32_t str_re_fail(str_re_parser_t *p, const char *error) {
+    if (p->error == NULL) {
+        p->error = error;
+    }
+    return STR_RE_NONE;
+}
+
+static uint32_t str_re_node(str_re_parser_t *p, uint8_t type) {
+    str_re_node_t *nodes = str_re_grow(p->allocator, p->nodes, &p->node_cap, p->node_count, sizeof(str_re_node_t));
+    if (nodes == NULL) {
+        return str_re_fail(p, "out of memory");
+    }
+    p->nodes = nodes;
+    p->nodes[p->node_count] = (str_re_node_t){type, 0, 0, 0, STR_RE_NONE, STR_RE_NONE, STR_RE_NONE, STR_RE_NONE};
+    return p->node_count++;
+}
+
+static uint32_t str_re_set_node(str_re_parser_t *p, const str_re_set_t *set) {
+    str_re_set_t *sets = str_re_grow(p->allocator, p->sets, &p->set_cap, p->set_count, sizeof(str_re_set_t));
+    if (sets == NULL) {
+        return str_re_fail(p, "out of memory");
+    }
+    p->sets = sets;
+    uint32_t node = str_re_node(p, STR_RE_SET);
+    if (node != STR_RE_NONE) {
+        p->sets[p->set_count] = *set;
+        p->nodes[node].set = p->set_count++;
+    }
+    return node;
+}
+
+// append child to the children of parent
+static void str_re_add_child(str_re_parser_t *p, uint32_t parent, uint32_t child) {
+    str_re_node_t *node = &p->nodes[parent];
+    if (node->first == STR_RE_NONE) {
+        node->first = child;
+    } else {
+        p->nodes[node->last].next = child;
+        p->nodes[child].prev = node->last;
+    }
+    node->last = child;
+}
+
+// add the class of \d, \w, \s or their negations to set, false for any other
+// escape
+static bool str_re_class_escape(char ch, str_re_set_t *set) {
+    str_re_set_t temp = {{0}};
+    switch (ch | 0x20) {
+        case 'd':
+            str_re_set_range(&temp, '0', '9');
+            break;
+        case 'w':
+            str_re_set_range(&temp, '0', '9');
+            str_re_set_range(&temp, 'A', 'Z');
+            str_re_set_range(&temp, 'a', 'z');
+            str_re_set_range(&temp, '_', '_');
+            break;
+        case 's':
+            str_re_set_range(&temp, '\t', '\r');
+            str_re_set_range(&temp, ' ', ' ');
+            break;
+        default:
+            return false;
+    }
+    if (ch >= 'A' && ch <= 'Z') {
+        str_re_set_invert(&temp);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        set->bits[i] |= temp.bits[i];
+    }
+    return true;
+}
+
+// parse the escaped byte after a backslash, returns -1 on error
+static int str_re_byte_escape(str_re_parser_t *p) {
+    if (p->ptr == p->end) {
+        return (str_re_fail(p, "trailing backslash in regex"), -1);
+    }
+    char ch = *p->ptr++;
+    switch (ch) {
+        case 'n':
+            return '\n';
+        case 't':
+            return '\t';
+        case 'r':
+            return '\r';
+        case 'f':
+            return '\f';
+        case 'v':
+            return '\v';
+        case '0':
+            return 0;
+        case 'x': {
+            int value = 0;
+            for (int i = 0; i < 2; i++) {
+                char digit = p->ptr < p->end ? *p->ptr : 0;
+                if (!isxdigit((unsigned char)digit)) {
+                    return (str_re_fail(p, "bad \\x escape in regex"), -1);
                 }
+                value = value * 16 + (isdigit((unsigned char)digit) ? digit - '0' : (digit | 0x20) - 'a' + 10);
+                p->ptr++;
+            }
+            return value;
+        }
+        default:
+            // letters and digits are kept for escapes that may mean something later
+            if (isalnum((unsigned char)ch)) {
+                return (str_re_fail(p, "unknown escape in regex"), -1);
+            }
+            return (unsigned char)ch;
+    }
+}
+
+// parse a bracket expression, p->ptr is right after the [
+static uint32_t str_re_parse_class(str_re_parser_t *p) {
+    str_re_set_t set = {{0}};
+    bool negate = p->ptr < p->end && *p->ptr == '^';
+    if (negate) {
+        p->ptr++;
+    }
+    // a ] right after the [ or [^ is literal
+    for (bool first = true; p->ptr < p->end && (*p->ptr != ']' || first); first = false) {
+        int lo;
+        if (*p->ptr == '\\') {
+            p->ptr++;
+            if (p->ptr < p->end && str_re_class_escape(*p->ptr, &set)) {
+                p->ptr++;
+                continue;
+            }
+            lo = str_re_byte_escape(p);
+        } else {
+            lo = (unsigned char)*p->ptr++;
+        }
+        if (lo < 0) {
+            return STR_RE_NONE;
+        }
+        int hi = lo;
+        if (p->end - p->ptr >= 2 && p->ptr[0] == '-' && p->ptr[1] != ']') {
+            p->ptr++;
+            if (*p->ptr == '\\') {
+                p->ptr++;
+                hi = str_re_byte_escape(p);
             } else {
-                if ((sub_len - current_char - 1) % abs_step == 0) {
-                    total_size += 1;
+                hi = (unsigned char)*p->ptr++;
+            }
+            if (hi < 0) {
+                return STR_RE_NONE;
+            }
+            if (hi < lo) {
+                return str_re_fail(p, "bad range in regex");
+            }
+        }
+        str_re_set_range(&set, (unsigned char)lo, (unsigned char)hi);
+    }
+    if (p->ptr == p->end) {
+        return str_re_fail(p, "missing ] in regex");
+    }
+    p->ptr++;
+    if (negate) {
+        str_re_set_invert(&set);
+    }
+    return str_re_set_node(p, &set);
+}
+
+static uint32_t str_re_parse_alt(str_re_parser_t *p);
+
+static uint32_t str_re_parse_atom(str_re_parser_t *p) {
+    str_re_set_t set = {{0}};
+    char ch = *p->ptr++;
+    switch (ch) {
+        case '(': {
+            if (++p->depth > STR_REGEX_MAX_DEPTH) {
+                return str_re_fail(p, "regex nested too deep");
+            }
+            uint32_t node = str_re_parse_alt(p);
+            p->depth--;
+            if (node == STR_RE_NONE) {
+                return STR_RE_NONE;
+            }
+            if (p->ptr == p->end) {
+                return str_re_fail(p, "missing ) in regex");
+            }
+            p->ptr++;
+            return node;
+        }
+        case '[':
+            return str_re_parse_class(p);
+        case '.':
+            str_re_set_range(&set, 0, 255);
+            set.bits['\n' >> 6] &= ~(1ull << ('\n' & 63));
+            break;
+        case '\\': {
+            if (p->ptr < p->end && str_re_class_escape(*p->ptr, &set)) {
+                p->ptr++;
+                break;
+            }
+            int byte = str_re_byte_escape(p);
+            if (byte < 0) {
+                return STR_RE_NONE;
+            }
+            str_re_set_range(&set, (unsigned char)byte, (unsigned char)byte);
+            break;
+        }
+        case '*':
+        case '+':
+        case '?':
+            return str_re_fail(p, "nothing to repeat in regex");
+        case '^':
+        case '$': {
+            uint32_t node = str_re_node(p, STR_RE_ANCHOR);
+            if (node != STR_RE_NONE) {
+                p->nodes[node].set = ch == '^' ? STR_RE_TEXT_BEGIN : STR_RE_TEXT_END;
+            }
+            return node;
+        }
+        default:
+            str_re_set_range(&set, (unsigned char)ch, (unsigned char)ch);
+            break;
+    }
+    return str_re_set_node(p, &set);
+}
+
+// parse {m}, {m,} or {m,n} at p->ptr. anything else is not a count and the
+// brace is taken literally
+static bool str_re_parse_count(str_re_parser_t *p, int32_t *min, int32_t *max) {
+    const char *ptr = p->ptr + 1;
+    int32_t bounds[2] = {0, -1};
+    for (int i = 0; i < 2; i++) {
+        if (ptr == p->end || !isdigit((unsigned char)*ptr)) {
+            if (i == 0) {
+                return false;
+            }
+            break;
+        }
+        bounds[i] = 0;
+        for (; ptr < p->end && isdigit((unsigned char)*ptr); ptr++) {
+            if (bounds[i] <= STR_REGEX_MAX_REPEAT) {
+                bounds[i] = bounds[i] * 10 + (*ptr - '0');
+            }
+        }
+        if (i == 0) {
+            if (ptr < p->end && *ptr == '}') {
+                bounds[1] = bounds[0];
+                break;
+            }
+            if (ptr == p->end || *ptr != ',') {
+                return false;
+            }
+            ptr++;
+        }
+    }
+    if (ptr == p->end || *ptr != '}') {
+        return false;
+    }
+    if (bounds[0] > STR_REGEX_MAX_REPEAT || bounds[1] > STR_REGEX_MAX_REPEAT) {
+        return (str_re_fail(p, "repeat count too large in regex"), false);
+    }
+    if (bounds[1] >= 0 && bounds[1] < bounds[0]) {
+        return (str_re_fail(p, "bad repeat count in regex"), false);
+    }
+    p->ptr = ptr + 1;
+    *min = bounds[0];
+    *max = bounds[1];
+    return true;
+}
+
+static uint32_t str_re_parse_repeat(str_re_parser_t *p) {
+    uint32_t node = str_re_parse_atom(p);
+    for (uint32_t depth = p->depth; node != STR_RE_NONE && p->ptr < p->end; depth++) {
+        int32_t min = 0;
+        int32_t max = -1;
+        switch (*p->ptr) {
+            case '*':
+                p->ptr++;
+                break;
+            case '+':
+                p->ptr++;
+                min = 1;
+                break;
+            case '?':
+                p->ptr++;
+                max = 1;
+                break;
+            case '{':
+                if (str_re_parse_count(p, &min, &max)) {
+                    break;
                 }
+                return p->error != NULL ? STR_RE_NONE : node;
+            default:
+                return node;
+        }
+        if (depth >= STR_REGEX_MAX_DEPTH) {
+            return str_re_fail(p, "regex nested too deep");
+        }
+        uint32_t repeat = str_re_node(p, STR_RE_REPEAT);
+        if (repeat == STR_RE_NONE) {
+            return STR_RE_NONE;
+        }
+        p->nodes[repeat].min = min;
+        p->nodes[repeat].max = max;
+        p->nodes[repeat].first = p->nodes[repeat].last = node;
+        node = repeat;
+    }
+    return node;
+}
+
+static uint32_t str_re_parse_cat(str_re_parser_t *p) {
+    uint32_t node = STR_RE_NONE;
+    uint32_t cat = STR_RE_NONE;
+    while (p->ptr < p->end && *p->ptr != '|' && *p->ptr != ')') {
+        uint32_t child = str_re_parse_repeat(p);
+        if (child == STR_RE_NONE) {
+            return STR_RE_NONE;
+        }
+        if (node == STR_RE_NONE) {
+            node = child;
+            continue;
+        }
+        if (cat == STR_RE_NONE) {
+            if ((cat = str_re_node(p, STR_RE_CAT)) == STR_RE_NONE) {
+                return STR_RE_NONE;
             }
-        } else if ((*str & 0xE0) == 0xC0) {
-            str += 2;
-            info[current_char] = 2;
-            if (step > 0) {
-                if (current_char % abs_step == 0) {
-                    total_size += 2;
+            str_re_add_child(p, cat, node);
+            node = cat;
+        }
+        str_re_add_child(p, cat, child);
+    }
+    return node != STR_RE_NONE ? node : str_re_node(p, STR_RE_EMPTY);
+}
+
+static uint32_t str_re_parse_alt(str_re_parser_t *p) {
+    uint32_t node = str_re_parse_cat(p);
+    uint32_t alt = STR_RE_NONE;
+    while (node != STR_RE_NONE && p->ptr < p->end && *p->ptr == '|') {
+        p->ptr++;
+        uint32_t child = str_re_parse_cat(p);
+        if (child == STR_RE_NONE) {
+            return STR_RE_NONE;
+        }
+        if (alt == STR_RE_NONE) {
+            if ((alt = str_re_node(p, STR_RE_ALT)) == STR_RE_NONE) {
+                return STR_RE_NONE;
+            }
+            str_re_add_child(p, alt, node);
+            node = alt;
+        }
+        str_re_add_child(p, alt, child);
+    }
+    return node;
+}
+
+static uint32_t str_re_inst(str_regex_t *re, str_re_prog_t *prog, uint8_t op, uint32_t set, uint32_t out, uint32_t out1) {
+    if (prog->inst_count == STR_REGEX_MAX_INSTS) {
+        return STR_RE_NONE;
+    }
+    str_re_inst_t *insts = str_re_grow(re->allocator, prog->insts, &prog->inst_cap, prog->inst_count, sizeof(str_re_inst_t));
+    if (insts == NULL) {
+        return STR_RE_NONE;
+    }
+    prog->insts = insts;
+    prog->insts[prog->inst_count] = (str_re_inst_t){op, set, out, out1};
+    return prog->inst_count++;
+}
+
+// emit the instructions of node so that they continue at next, returns the
+// first instruction. the nfa is built back to front, reversed programs walk the
+// children of a concatenation the other way around
+static uint32_t str_re_compile(str_regex_t *re, str_re_prog_t *prog, const str_re_node_t *nodes, uint32_t index, uint32_t next, bool reverse) {
+    const str_re_node_t *node = &nodes[index];
+    switch (node->type) {
+        case STR_RE_EMPTY:
+            return next;
+        case STR_RE_SET:
+            return str_re_inst(re, prog, STR_RE_BYTE, node->set, next, 0);
+        case STR_RE_ANCHOR:
+            return str_re_inst(re, prog, STR_RE_ASSERT, (node->set == STR_RE_TEXT_BEGIN) != reverse ? STR_RE_AT_FIRST : STR_RE_AT_LAST, next, 0);
+        case STR_RE_CAT:
+            for (uint32_t child = reverse ? node->first : node->last; child != STR_RE_NONE && next != STR_RE_NONE;
+                 child = reverse ? nodes[child].next : nodes[child].prev) {
+                next = str_re_compile(re, prog, nodes, child, next, reverse);
+            }
+            return next;
+        case STR_RE_ALT: {
+            uint32_t tail = str_re_compile(re, prog, nodes, node->last, next, reverse);
+            for (uint32_t child = nodes[node->last].prev; child != STR_RE_NONE && tail != STR_RE_NONE; child = nodes[child].prev) {
+                uint32_t branch = str_re_compile(re, prog, nodes, child, next, reverse);
+                tail = branch != STR_RE_NONE ? str_re_inst(re, prog, STR_RE_SPLIT, 0, branch, tail) : STR_RE_NONE;
+            }
+            return tail;
+        }
+        default: {
+            // x{m,n} is m copies of x followed by n - m nested optional ones
+            uint32_t tail = next;
+            if (node->max < 0) {
+                uint32_t split = str_re_inst(re, prog, STR_RE_SPLIT, 0, 0, next);
+                uint32_t body = split != STR_RE_NONE ? str_re_compile(re, prog, nodes, node->first, split, reverse) : STR_RE_NONE;
+                if (body == STR_RE_NONE) {
+                    return STR_RE_NONE;
                 }
-            } else {
-                if ((sub_len - current_char - 1) % abs_step == 0) {
-                    total_size += 2;
+                prog->insts[split].out = body;
+                tail = split;
+            }
+            for (int32_t i = node->min; i < node->max && tail != STR_RE_NONE; i++) {
+                uint32_t body = str_re_compile(re, prog, nodes, node->first, tail, reverse);
+                tail = body != STR_RE_NONE ? str_re_inst(re, prog, STR_RE_SPLIT, 0, body, next) : STR_RE_NONE;
+            }
+            for (int32_t i = 0; i < node->min && tail != STR_RE_NONE; i++) {
+                tail = str_re_compile(re, prog, nodes, node->first, tail, reverse);
+            }
+            return tail;
+        }
+    }
+}
+
+// allocate the dfa cache and the scratch space of prog in one block
+static bool str_re_prog_init(str_regex_t *re, str_re_prog_t *prog) {
+    size_t list_max = (size_t)prog->inst_count * 2 + 2;
+    size_t list_cap = STR_REGEX_STATES * 16 + list_max;
+    size_t size = sizeof(str_re_dstate_t) * STR_REGEX_STATES + sizeof(int32_t) * STR_REGEX_STATES * re->stride +
+                  sizeof(uint32_t) * (list_cap + STR_REGEX_STATES * 2 + list_max * 2 + prog->inst_count * 2);
+    prog->states = str_raw_alloc(re->allocator, size);
+    if (prog->states == NULL) {
+        return false;
+    }
+    prog->trans = (int32_t *)(prog->states + STR_REGEX_STATES);
+    prog->lists = (uint32_t *)(prog->trans + STR_REGEX_STATES * re->stride);
+    prog->list_cap = (uint32_t)list_cap;
+    prog->table = prog->lists + list_cap;
+    prog->buffers[0] = prog->table + STR_REGEX_STATES * 2;
+    prog->buffers[1] = prog->buffers[0] + list_max;
+    prog->stack = prog->buffers[1] + list_max;
+    prog->marks = prog->stack + prog->inst_count;
+    memset(prog->table, 0, sizeof(uint32_t) * STR_REGEX_STATES * 2);
+    memset(prog->marks, 0, sizeof(uint32_t) * prog->inst_count);
+    prog->state_count = 0;
+    prog->list_used = 0;
+    prog->mark = 0;
+    return true;
+}
+
+static void str_re_flush(str_re_prog_t *prog) {
+    prog->state_count = 0;
+    prog->list_used = 0;
+    memset(prog->table, 0, sizeof(uint32_t) * STR_REGEX_STATES * 2);
+}
+
+// start a new closure, instructions marked before are not in it
+static inline void str_re_next_mark(str_re_prog_t *prog) {
+    if (++prog->mark == 0) {
+        memset(prog->marks, 0, sizeof(uint32_t) * prog->inst_count);
+        prog->mark = 1;
+    }
+}
+
+// add the instructions reachable from inst over epsilon edges that are not in
+// list yet, returns the new length. assertions in holds are passed, the others
+// at the first position are dropped and the ones at the last are kept waiting
+static uint32_t str_re_closure(str_re_prog_t *prog, uint32_t inst, uint32_t *list, uint32_t length, uint32_t holds) {
+    uint32_t *stack = prog->stack;
+    uint32_t *marks = prog->marks;
+    uint32_t top = 0;
+    if (marks[inst] == prog->mark) {
+        return length;
+    }
+    marks[inst] = prog->mark;
+    stack[top++] = inst;
+    while (top != 0) {
+        uint32_t index = stack[--top];
+        const str_re_inst_t *ip = &prog->insts[index];
+        if (ip->op == STR_RE_ASSERT) {
+            if (holds & ip->set) {
+                if (marks[ip->out] != prog->mark) {
+                    marks[ip->out] = prog->mark;
+                    stack[top++] = ip->out;
                 }
+            } else if (ip->set == STR_RE_AT_LAST) {
+                list[length++] = index;
+            }
+            continue;
+        }
+        if (ip->op != STR_RE_SPLIT) {
+            list[length++] = index;
+            continue;
+        }
+        if (marks[ip->out1] != prog->mark) {
+            marks[ip->out1] = prog->mark;
+            stack[top++] = ip->out1;
+        }
+        if (marks[ip->out] != prog->mark) {
+            marks[ip->out] = prog->mark;
+            stack[top++] = ip->out;
+        }
+    }
+    return length;
+}
+
+// write the state reached from list over byte to out and return its length.
+// a byte of -1 builds the initial state, first tells if ^ holds there
+static uint32_t str_re_step(const str_regex_t *re, str_re_prog_t *prog, const uint32_t *list, uint32_t length, uint32_t flags, int byte, bool first,
+                            uint32_t *out, uint32_t *out_flags) {
+    str_re_next_mark(prog);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        if (list[i] == STR_RE_SEP) {
+            if (count != 0 && out[count - 1] != STR_RE_SEP) {
+                out[count++] = STR_RE_SEP;
+            }
+            continue;
+        }
+        const str_re_inst_t *ip = &prog->insts[list[i]];
+        if (ip->op == STR_RE_BYTE && str_re_set_has(&re->sets[ip->set], (unsigned char)byte)) {
+            count = str_re_closure(prog, ip->out, out, count, 0);
+        }
+    }
+    // until something matches a thread is started at every position. later
+    // starts go last, so a state is a list of groups ordered by start
+    if (byte < 0 || !(flags & (STR_RE_ANCHORED | STR_RE_MATCHED))) {
+        if (count != 0 && out[count - 1] != STR_RE_SEP) {
+            out[count++] = STR_RE_SEP;
+        }
+        count = str_re_closure(prog, prog->start, out, count, byte < 0 && first ? STR_RE_AT_FIRST : 0);
+    }
+    if (count != 0 && out[count - 1] == STR_RE_SEP) {
+        count--;
+    }
+    flags &= STR_RE_ANCHORED | STR_RE_MATCHED;
+    // the first group with a match wins, threads that started later can only
+    // give matches further right
+    for (uint32_t i = 0; i < count; i++) {
+        if (out[i] != STR_RE_SEP && prog->insts[out[i]].op == STR_RE_MATCH) {
+            while (i < count && out[i] != STR_RE_SEP) {
+                i++;
+            }
+            count = i;
+            flags |= STR_RE_MATCHED | STR_RE_IS_MATCH;
+            break;
+        }
+    }
+    if (count == 0 && (flags & (STR_RE_ANCHORED | STR_RE_MATCHED))) {
+        flags |= STR_RE_DEAD;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (out[i] != STR_RE_SEP && prog->insts[out[i]].op == STR_RE_ASSERT) {
+            flags |= STR_RE_WAITING;
+            break;
+        }
+    }
+    *out_flags = flags;
+    return count;
+}
+
+// whether a thread of list waiting for the last position matches there, first
+// tells if that is the first position too. scratch is space for a state
+static bool str_re_finish(str_re_prog_t *prog, const uint32_t *list, uint32_t length, uint32_t flags, bool first, uint32_t *scratch) {
+    if (!(flags & STR_RE_WAITING)) {
+        return false;
+    }
+    str_re_next_mark(prog);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        if (list[i] != STR_RE_SEP && prog->insts[list[i]].op == STR_RE_ASSERT) {
+            count = str_re_closure(prog, list[i], scratch, count, STR_RE_AT_LAST | (first ? STR_RE_AT_FIRST : 0));
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (prog->insts[scratch[i]].op == STR_RE_MATCH) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// find the cached state of list or add it, returns -1 when the cache is full
+static int32_t str_re_state(const str_regex_t *re, str_re_prog_t *prog, const uint32_t *list, uint32_t length, uint32_t flags) {
+    uint32_t hash = 2166136261u ^ flags;
+    for (uint32_t i = 0; i < length; i++) {
+        hash = (hash ^ list[i]) * 16777619u;
+    }
+    uint32_t mask = STR_REGEX_STATES * 2 - 1;
+    uint32_t slot = hash & mask;
+    for (; prog->table[slot] != 0; slot = (slot + 1) & mask) {
+        const str_re_dstate_t *state = &prog->states[prog->table[slot] - 1];
+        if (state->flags == flags && state->length == length && memcmp(prog->lists + state->list, list, sizeof(uint32_t) * length) == 0) {
+            return (int32_t)(prog->table[slot] - 1);
+        }
+    }
+    if (prog->state_count == STR_REGEX_STATES || prog->list_cap - prog->list_used < length) {
+        return -1;
+    }
+    uint32_t index = prog->state_count++;
+    memcpy(prog->lists + prog->list_used, list, sizeof(uint32_t) * length);
+    prog->states[index] = (str_re_dstate_t){prog->list_used, length, flags};
+    prog->list_used += length;
+    prog->table[slot] = index + 1;
+    int32_t *trans = prog->trans + (size_t)index * re->stride;
+    for (uint32_t i = 0; i < re->stride; i++) {
+        trans[i] = -1;
+    }
+    return (int32_t)index;
+}
+
+// run prog from index from to index to of a text of size bytes, backwards for
+// the reversed program, and return the index where the longest match ends, or
+// -1. the dfa falls back to stepping the nfa without caching once the cache
+// keeps filling up
+static int64_t str_re_run(str_regex_t *re, str_re_prog_t *prog, const char *text, size_t size, size_t from, size_t to, bool anchored) {
+    bool reverse = prog == &re->reverse;
+    bool first = from == (reverse ? size : 0);
+    bool edge = to == (reverse ? 0 : size);
+    const char *prefix = !reverse && !anchored && re->prefix_length != 0 ? re->prefix : NULL;
+    const uint8_t *classes = re->classes;
+    size_t stride = re->stride;
+    uint32_t *list = prog->buffers[0];
+    uint32_t *next = prog->buffers[1];
+    uint32_t flags;
+    uint32_t length = str_re_step(re, prog, NULL, 0, anchored ? STR_RE_ANCHORED : 0, -1, first, list, &flags);
+    int32_t start = str_re_state(re, prog, list, length, flags);
+    if (start < 0) {
+        str_re_flush(prog);
+        start = str_re_state(re, prog, list, length, flags);
+    }
+    int32_t state = start;
+    bool cached = state >= 0;
+    size_t flushed_at = from;
+    uint32_t flushes = 0;
+    int64_t last = -1;
+    for (size_t pos = from;; pos = reverse ? pos - 1 : pos + 1) {
+        if (flags & STR_RE_IS_MATCH) {
+            last = (int64_t)pos;
+        }
+        if ((flags & STR_RE_DEAD) || pos == to) {
+            // threads waiting for the end of the text go on there
+            if (pos == to && edge && (flags & STR_RE_WAITING)) {
+                const uint32_t *current = cached ? prog->lists + prog->states[state].list : list;
+                uint32_t count = cached ? prog->states[state].length : length;
+                last = str_re_finish(prog, current, count, flags, first && pos == from, next) ? (int64_t)pos : last;
             }
-        } else if ((*str & 0xF0) == 0xE0) {
-            str += 3;
-            info[current_char] = 3;
-            if (step > 0) {
-                if (current_char % abs_step == 0) {
-                    total_size += 3;
-                }
-            } else {
-                if ((sub_len - current_char - 1) % abs_step == 0) {
-                    total_size += 3;
+            return last;
+        }
+        if (!cached) {
+            unsigned char byte = reverse ? text[pos - 1] : text[pos];
+            length = str_re_step(re, prog, list, length, flags, byte, false, next, &flags);
+            uint32_t *temp = list;
+            list = next;
+            next = temp;
+            continue;
+        }
+        // transitions hold the row of the target, with the low bit set when it
+        // is not known yet or the target matches or is dead. runs spend most of
+        // their time in these loops
+        const int32_t *trans = prog->trans;
+        size_t row = (size_t)state * stride;
+        if (reverse) {
+            for (int32_t target; pos != to; row = (size_t)target, pos--) {
+                target = trans[row + classes[(unsigned char)text[pos - 1]]];
+                if (target & 1) {
+                    break;
                 }
             }
-        } else if ((*str & 0xF8) == 0xF0) {
-            str += 4;
-            info[current_char] = 4;
-            if (step > 0) {
-                if (current_char % abs_step == 0) {
-                    total_size += 4;
-                }
-            } else {
-                if ((sub_len - current_char - 1) % abs_step == 0) {
-                    total_size += 4;
+        } else {
+            size_t start_row = prefix != NULL && start >= 0 ? (size_t)start * stride : SIZE_MAX;
+            for (int32_t target; pos != to && row != start_row; row = (size_t)target, pos++) {
+                target = trans[row + classes[(unsigned char)text[pos]]];
+                if (target & 1) {
+                    break;
                 }
             }
-        } else {
-#if defined(__STDC_NO_VLA__)
-            free(info);
-#endif
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
-#else
-            return NULL;
-#endif
         }
-        current_char++;
+        state = (int32_t)(row / stride);
+        if (pos == to) {
+            const str_re_dstate_t *current = &prog->states[state];
+            bool found = edge && str_re_finish(prog, prog->lists + current->list, current->length, current->flags, first && pos == from, next);
+            return found ? (int64_t)pos : last;
+        }
+        // nothing is going on, so skip ahead to where a match can start
+        if (state == start && prefix != NULL) {
+            const char *hit = str_memmem(text + pos, to - pos, prefix, re->prefix_length);
+            if (hit == NULL) {
+                return last;
+            }
+            pos = hit - text;
+        }
+        unsigned char byte = reverse ? text[pos - 1] : text[pos];
+        int32_t *slot = &prog->trans[(size_t)state * stride + classes[byte]];
+        if (*slot >= 0) {
+            state = (int32_t)((size_t)(*slot & ~1) / stride);
+            flags = prog->states[state].flags;
+            continue;
+        }
+        const str_re_dstate_t *current = &prog->states[state];
+        length = str_re_step(re, prog, prog->lists + current->list, current->length, current->flags, byte, false, list, &flags);
+        int32_t target = str_re_state(re, prog, list, length, flags);
+        if (target >= 0) {
+            *slot = (int32_t)((size_t)target * stride) | ((flags & (STR_RE_IS_MATCH | STR_RE_DEAD)) != 0);
+            state = target;
+            continue;
+        }
+        // a cache that fills up every few bytes is slower than the nfa itself
+        if (++flushes > 8 && (reverse ? flushed_at - pos : pos - flushed_at) < (size_t)STR_REGEX_STATES * 16) {
+            cached = false;
+            continue;
+        }
+        flushed_at = pos;
+        str_re_flush(prog);
+        state = str_re_state(re, prog, list, length, flags);
+        cached = state >= 0;
+        if (cached && prefix != NULL) {
+            uint32_t start_flags;
+            uint32_t start_length = str_re_step(re, prog, NULL, 0, 0, -1, false, next, &start_flags);
+            start = str_re_state(re, prog, next, start_length, start_flags);
+        }
     }
+}
 
-    string_t *result = NULL;
-    if (str_resize(&result, total_size)) {
-        size_t index = 0;
-        size_t curr = 0;
-        if (step > 0) {
-            for (size_t i = 0; i < sub_len;) {
-                memcpy(&result->cstr[index], &ptr[curr], info[i]);
-                index += info[i];
-                for (size_t j = 0; j < abs_step; j++) {
-                    if (i < sub_len) {
-                        curr += info[i];
-                        i++;
+// leftmost longest match at or after start, returns its index and sets end
+static int64_t str_re_search(str_regex_t *re, const char *text, size_t length, size_t start, size_t *end) {
+    if (re->anchor_start && start != 0) {
+        return -1;
+    }
+    // with only $ the match ends at the end of the text, so it is found
+    // backwards from there
+    if (re->anchor_end && !re->anchor_start) {
+        int64_t index = str_re_run(re, &re->reverse, text, length, length, start, true);
+        *end = length;
+        return index;
+    }
+    int64_t stop = str_re_run(re, &re->forward, text, length, start, length, re->anchor_start);
+    if (stop < 0) {
+        return -1;
+    }
+    *end = (size_t)stop;
+    return re->anchor_start ? 0 : str_re_run(re, &re->reverse, text, length, (size_t)stop, start, true);
+}
+
+// collect the literal bytes every match starts with, returns if all of node is
+// literal so the bytes after it can be collected too
+static bool str_re_prefix(str_regex_t *re, const str_re_node_t *nodes, uint32_t index) {
+    const str_re_node_t *node = &nodes[index];
+    switch (node->type) {
+        case STR_RE_EMPTY:
+            return true;
+        case STR_RE_SET: {
+            const str_re_set_t *set = &re->sets[node->set];
+            int byte = -1;
+            for (int i = 0; i < 256; i++) {
+                if (str_re_set_has(set, (unsigned char)i)) {
+                    if (byte >= 0) {
+                        return false;
                     }
+                    byte = i;
                 }
             }
-        } else {
-            curr = str - ptr - info[sub_len - 1];
-            // i <= sub_len for unsigned integer overflow
-            for (size_t i = sub_len - 1; i <= sub_len;) {
-                memcpy(&result->cstr[index], &ptr[curr], info[i]);
-                index += info[i];
-                for (size_t j = 0; j < abs_step; j++) {
-                    if (i <= sub_len) {
-                        curr -= info[i];
-                        i--;
-                    }
+            if (byte < 0 || re->prefix_length == STR_REGEX_PREFIX) {
+                return false;
+            }
+            re->prefix[re->prefix_length++] = (char)byte;
+            return true;
+        }
+        case STR_RE_CAT:
+            for (uint32_t child = node->first; child != STR_RE_NONE; child = nodes[child].next) {
+                if (!str_re_prefix(re, nodes, child)) {
+                    return false;
+                }
+            }
+            return true;
+        case STR_RE_REPEAT:
+            for (int32_t i = 0; i < node->min; i++) {
+                if (!str_re_prefix(re, nodes, node->first)) {
+                    return false;
                 }
             }
+            return node->min == node->max;
+        default:
+            return false;
+    }
+}
+
+static void str_re_prog_free(const str_allocator_t *allocator, str_re_prog_t *prog) {
+    if (prog->insts != NULL) {
+        str_raw_free(allocator, prog->insts);
+    }
+    if (prog->states != NULL) {
+        str_raw_free(allocator, prog->states);
+    }
+}
+
+void str_regex_free(str_regex_t *re) {
+    if (re != NULL) {
+        str_re_prog_free(re->allocator, &re->forward);
+        str_re_prog_free(re->allocator, &re->reverse);
+        if (re->sets != NULL) {
+            str_raw_free(re->allocator, re->sets);
         }
-        result->cstr[result->length] = 0;
-#if defined(__STDC_NO_VLA__)
-        free(info);
-#endif
-        return result;
+        str_raw_free(re->allocator, re);
     }
-#if defined(__STDC_NO_VLA__)
-    free(info);
-#endif
-    return NULL;
 }
 
-string_t *str_utf8_slice(string_t **self, int64_t start, int64_t end, int64_t step) {
-    if (step == 0) {
+str_regex_t *str_regex_new(const char *pattern) {
+    const str_allocator_t *allocator = str_get_allocator();
+    str_regex_t *re = str_raw_alloc(allocator, sizeof(str_regex_t));
+    if (re == NULL) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: slice step cannot be zero\n", stderr), NULL);
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
 #else
         return NULL;
 #endif
     }
-    size_t str_length = str_utf8_strlen(*self);
-    size_t start_index;
-    size_t end_index;
-    if (step > 0) {
-        start_index = start == YASLI_START ? 0 : start == YASLI_END ? str_length : start >= 0 ? (size_t)start : str_length + start;
-        end_index = end == YASLI_START ? 0 : end == YASLI_END ? str_length : end > 0 ? (size_t)end : str_length + end;
-    } else {
-        start_index = end == YASLI_START ? 0 : end == YASLI_END ? str_length : end == 0 ? (size_t)end + 1 : end > 0 ? (size_t)end + 1 : str_length + end + 1;
-        end_index = start == YASLI_START ? 0
-                    : start == YASLI_END ? str_length
-                    : start == 0         ? str_length
-                    : start > 0          ? (size_t)start + 1
-                                         : str_length + start + 1;
+    memset(re, 0, sizeof(str_regex_t));
+    re->allocator = allocator;
+    str_re_parser_t parser = {0};
+    parser.ptr = pattern;
+    parser.end = pattern + strlen(pattern);
+    parser.allocator = allocator;
+    uint32_t root = str_re_parse_alt(&parser);
+    if (root != STR_RE_NONE && parser.ptr != parser.end) {
+        root = str_re_fail(&parser, "unmatched ) in regex");
     }
-    if (start_index > str_length) {
-        start_index = str_length;
+    re->sets = parser.sets;
+    re->set_count = parser.set_count;
+    if (root == STR_RE_NONE) {
+        goto fail;
     }
-    if (end_index > str_length) {
-        end_index = str_length;
+
+    // bytes no set tells apart share a column of the transition table
+    re->class_count = 1;
+    for (int i = 1; i < 256; i++) {
+        bool split = false;
+        for (uint32_t j = 0; j < re->set_count && !split; j++) {
+            split = str_re_set_has(&re->sets[j], (unsigned char)i) != str_re_set_has(&re->sets[j], (unsigned char)(i - 1));
+        }
+        re->classes[i] = (uint8_t)(split ? re->class_count++ : re->class_count - 1);
     }
-    if (start_index > end_index) {
+    re->stride = (re->class_count + 1) & ~1u;
+
+    for (int i = 0; i < 2; i++) {
+        str_re_prog_t *prog = i == 0 ? &re->forward : &re->reverse;
+        uint32_t match = str_re_inst(re, prog, STR_RE_MATCH, 0, 0, 0);
+        prog->start = match != STR_RE_NONE ? str_re_compile(re, prog, parser.nodes, root, match, i == 1) : STR_RE_NONE;
+        if (prog->start == STR_RE_NONE) {
+            parser.error = prog->inst_count == STR_REGEX_MAX_INSTS ? "regex too large" : "out of memory";
+            goto fail;
+        }
+        if (!str_re_prog_init(re, prog)) {
+            parser.error = "out of memory";
+            goto fail;
+        }
+        // with no thread left to start away from the edge, every match
+        // starts at the beginning of the text or ends at its end
+        str_re_next_mark(prog);
+        bool edge = str_re_closure(prog, prog->start, prog->buffers[0], 0, 0) == 0;
+        *(i == 0 ? &re->anchor_start : &re->anchor_end) = edge;
+    }
+    if (!re->anchor_start) {
+        str_re_prefix(re, parser.nodes, root);
+    }
+    if (parser.nodes != NULL) {
+        str_raw_free(allocator, parser.nodes);
+    }
+    return re;
+fail:
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
-#else
-        return NULL;
+    fprintf(stderr, "[ERRO]: %s\n", parser.error);
 #endif
+    if (parser.nodes != NULL) {
+        str_raw_free(allocator, parser.nodes);
     }
-    size_t sub_len = end_index - start_index;
-    size_t abs_step = llabs(step);
+    str_regex_free(re);
+    return NULL;
+}
 
-    // get to the starting index.
-    size_t current_char = 0;
-    const unsigned char *ptr = (const unsigned char *)(*self)->cstr;
-    while (current_char < start_index) {
-        if (*ptr == 0) {
+bool str_regex_match(str_regex_t *re, const string_t *src) {
+    return str_re_run(re, &re->forward, src->cstr, src->length, 0, src->length, true) == (int64_t)src->length;
+}
+
+int64_t str_regex_search(str_regex_t *re, const string_t *src, size_t start, size_t *length) {
+    if (start > src->length) {
 #ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+        return (fputs("[ERRO]: index out of bound\n", stderr), -1);
 #else
-            return NULL;
+        return -1;
 #endif
-        } else if ((*ptr & 0x80) == 0) {
-            ptr++;
-        } else if ((*ptr & 0xE0) == 0xC0) {
-            ptr += 2;
-        } else if ((*ptr & 0xF0) == 0xE0) {
-            ptr += 3;
-        } else if ((*ptr & 0xF8) == 0xF0) {
-            ptr += 4;
-        } else {
+    }
+    size_t end;
+    int64_t index = str_re_search(re, src->cstr, src->length, start, &end);
+    if (index >= 0 && length != NULL) {
+        *length = end - (size_t)index;
+    }
+    return index;
+}
+
+str_view_t *str_regex_find_all(str_regex_t *re, const string_t *src, size_t *count) {
+    size_t cap = 16;
+    size_t index = 0;
+    str_view_t *matches = str_mem_alloc(sizeof(str_view_t) * cap);
+    if (matches == NULL) {
+        goto oom;
+    }
+    size_t start = 0;
+    size_t end;
+    for (int64_t found; start <= src->length && (found = str_re_search(re, src->cstr, src->length, start, &end)) >= 0;) {
+        // one slot is always left for the terminating view
+        if (index + 2 > cap) {
+            str_view_t *result = str_mem_realloc(matches, sizeof(str_view_t) * cap, sizeof(str_view_t) * cap * 2);
+            if (result == NULL) {
+                str_mem_free(matches);
+                goto oom;
+            }
+            matches = result;
+            cap *= 2;
+        }
+        matches[index++] = (str_view_t){src->cstr + found, end - (size_t)found};
+        // an empty match would be found again at the same place
+        start = end != (size_t)found ? end : end + 1;
+    }
+    matches[index] = (str_view_t){NULL, 0};
+    if (count != NULL) {
+        *count = index;
+    }
+    return matches;
+oom:
 #ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+    return (fputs("[ERRO]: out of memory\n", stderr), NULL);
 #else
-            return NULL;
+    return NULL;
 #endif
-        }
-        current_char++;
+}
+
+string_t *str_regex_replaced(str_regex_t *re, const string_t *src, const char *new_val) {
+    size_t count;
+    str_view_t *matches = str_regex_find_all(re, src, &count);
+    if (matches == NULL) {
+        return NULL;
+    }
+    size_t new_len = strlen(new_val);
+    size_t length = src->length;
+    for (size_t i = 0; i < count; i++) {
+        length = length - matches[i].length + new_len;
+    }
+    string_t *result = NULL;
+    if (!str_resize(&result, length)) {
+        str_mem_free(matches);
+        return NULL;
     }
+    char *dest = result->cstr;
+    const char *prev = src->cstr;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(dest, prev, matches[i].data - prev);
+        dest += matches[i].data - prev;
+        memcpy(dest, new_val, new_len);
+        dest += new_len;
+        prev = matches[i].data + matches[i].length;
+    }
+    memcpy(dest, prev, src->cstr + src->length - prev);
+    result->cstr[length] = 0;
+    str_mem_free(matches);
+    return result;
+}
 
-    // get result length and utf-8 related information
-    current_char = 0;
-    const unsigned char *str = ptr;
-    size_t total_size = 0;
-#if defined(__STDC_NO_VLA__)
-    uint8_t *info = malloc(sizeof(uint8_t) * sub_len);
-#else
-    uint8_t info[sub_len];
-#endif
+// a glob is split on its stars into segments of fixed length. the first and
+// the last segment are tied to the ends of the text, the ones in between are
+// each found leftmost after the previous one, which never loses a match since
+// the stars around them can take up any length
 
-    while (current_char < sub_len) {
-        if (*str == 0) {
-#if defined(__STDC_NO_VLA__)
-            free(info);
-#endif
-#ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
-#else
+typedef struct str_glob_seg_t {
+    size_t start;     // first position in sets and bytes
+    size_t length;    // bytes it matches
+    uint64_t *masks;  // shift-and masks of a segment with wildcards, a word per 64 bytes
+    bool literal;     // no wildcards, found with str_memmem
+} str_glob_seg_t;
+
+struct str_glob_t {
+    size_t seg_count;  // one more than the number of stars
+    size_t min_length;
+    str_glob_seg_t *segs;
+    str_re_set_t *sets;  // bytes each position accepts
+    char *bytes;         // the bytes of literal positions
+    uint64_t *masks;
+    const str_allocator_t *allocator;
+};
+
+// parse the bracket expression at ptr into set, returns where it ends or NULL
+// if it is not terminated
+static const char *str_glob_class(const char *ptr, str_re_set_t *set) {
+    ptr++;
+    bool negate = *ptr == '!' || *ptr == '^';
+    if (negate) {
+        ptr++;
+    }
+    // a ] right after the [ or the negation is literal
+    for (bool first = true; *ptr != ']' || first; first = false) {
+        if (*ptr == 0) {
             return NULL;
-#endif
-        } else if ((*str & 0x80) == 0) {
-            str++;
-            info[current_char] = 1;
-            if (step > 0) {
-                if (current_char % abs_step == 0) {
-                    total_size += 1;
-                }
-            } else {
-                if ((sub_len - current_char - 1) % abs_step == 0) {
-                    total_size += 1;
-                }
-            }
-        } else if ((*str & 0xE0) == 0xC0) {
-            str += 2;
-            info[current_char] = 2;
-            if (step > 0) {
-                if (current_char % abs_step == 0) {
-                    total_size += 2;
-                }
-            } else {
-                if ((sub_len - current_char - 1) % abs_step == 0) {
-                    total_size += 2;
-                }
+        }
+        if (*ptr == '\\' && ptr[1] != 0) {
+            ptr++;
+        }
+        unsigned char lo = (unsigned char)*ptr++;
+        unsigned char hi = lo;
+        if (ptr[0] == '-' && ptr[1] != ']' && ptr[1] != 0) {
+            ptr++;
+            if (*ptr == '\\' && ptr[1] != 0) {
+                ptr++;
             }
-        } else if ((*str & 0xF0) == 0xE0) {
-            str += 3;
-            info[current_char] = 3;
-            if (step > 0) {
-                if (current_char % abs_step == 0) {
-                    total_size += 3;
-                }
-            } else {
-                if ((sub_len - current_char - 1) % abs_step == 0) {
-                    total_size += 3;
-                }
+            hi = (unsigned char)*ptr++;
+        }
+        if (lo <= hi) {
+            str_re_set_range(set, lo, hi);
+        }
+    }
+    if (negate) {
+        str_re_set_invert(set);
+    }
+    return ptr + 1;
+}
+
+str_glob_t *str_glob_new(const char *pattern) {
+    const str_allocator_t *allocator = str_get_allocator();
+    size_t length = strlen(pattern);
+    // every byte of the pattern makes at most one position or one segment
+    str_glob_t *glob = str_raw_alloc(allocator, sizeof(str_glob_t) + sizeof(str_glob_seg_t) * (length + 1) + sizeof(str_re_set_t) * length + length);
+    if (glob == NULL) {
+        goto oom;
+    }
+    glob->segs = (str_glob_seg_t *)(glob + 1);
+    glob->sets = (str_re_set_t *)(glob->segs + length + 1);
+    glob->bytes = (char *)(glob->sets + length);
+    glob->masks = NULL;
+    glob->allocator = allocator;
+    glob->seg_count = 1;
+    glob->min_length = 0;
+    glob->segs[0] = (str_glob_seg_t){0, 0, NULL, true};
+    size_t count = 0;
+    for (const char *ptr = pattern; *ptr != 0;) {
+        str_glob_seg_t *seg = &glob->segs[glob->seg_count - 1];
+        if (*ptr == '*') {
+            glob->segs[glob->seg_count++] = (str_glob_seg_t){count, 0, NULL, true};
+            ptr++;
+            continue;
+        }
+        str_re_set_t *set = &glob->sets[count];
+        memset(set, 0, sizeof(str_re_set_t));
+        glob->bytes[count] = 0;
+        const char *end;
+        if (*ptr == '?') {
+            str_re_set_range(set, 0, 255);
+            seg->literal = false;
+            ptr++;
+        } else if (*ptr == '[' && (end = str_glob_class(ptr, set)) != NULL) {
+            seg->literal = false;
+            ptr = end;
+        } else {
+            // an unterminated [ is literal
+            memset(set, 0, sizeof(str_re_set_t));
+            if (*ptr == '\\' && ptr[1] != 0) {
+                ptr++;
             }
-        } else if ((*str & 0xF8) == 0xF0) {
-            str += 4;
-            info[current_char] = 4;
-            if (step > 0) {
-                if (current_char % abs_step == 0) {
-                    total_size += 4;
-                }
-            } else {
-                if ((sub_len - current_char - 1) % abs_step == 0) {
-                    total_size += 4;
+            glob->bytes[count] = *ptr;
+            str_re_set_range(set, (unsigned char)*ptr, (unsigned char)*ptr);
+            ptr++;
+        }
+        seg->length++;
+        count++;
+        glob->min_length++;
+    }
+
+    // segments with wildcards are found by shift-and, a longer one spreads
+    // the state over several words
+    size_t mask_count = 0;
+    for (size_t i = 0; i < glob->seg_count; i++) {
+        mask_count += glob->segs[i].literal ? 0 : (glob->segs[i].length + 63) / 64;
+    }
+    if (mask_count != 0) {
+        glob->masks = str_raw_alloc(allocator, sizeof(uint64_t) * 256 * mask_count);
+        if (glob->masks == NULL) {
+            str_raw_free(allocator, glob);
+            goto oom;
+        }
+        memset(glob->masks, 0, sizeof(uint64_t) * 256 * mask_count);
+    }
+    uint64_t *masks = glob->masks;
+    for (size_t i = 0; i < glob->seg_count; i++) {
+        str_glob_seg_t *seg = &glob->segs[i];
+        if (seg->literal) {
+            continue;
+        }
+        size_t words = (seg->length + 63) / 64;
+        seg->masks = masks;
+        masks += 256 * words;
+        for (size_t j = 0; j < seg->length; j++) {
+            for (int byte = 0; byte < 256; byte++) {
+                if (str_re_set_has(&glob->sets[seg->start + j], (unsigned char)byte)) {
+                    seg->masks[byte * words + j / 64] |= 1ull << (j % 64);
                 }
             }
-        } else {
-#if defined(__STDC_NO_VLA__)
-            free(info);
-#endif
+        }
+    }
+    return glob;
+oom:
 #ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), NULL);
+    return (fputs("[ERRO]: out of memory\n", stderr), NULL);
 #else
-            return NULL;
+    return NULL;
 #endif
+}
+
+void str_glob_free(str_glob_t *glob) {
+    if (glob != NULL) {
+        if (glob->masks != NULL) {
+            str_raw_free(glob->allocator, glob->masks);
         }
-        current_char++;
+        str_raw_free(glob->allocator, glob);
     }
+}
 
-#if defined(__STDC_NO_VLA__)
-    char *result = malloc(sizeof(char) * total_size);
-#else
-    char result[total_size];
-#endif
+// return if seg matches the bytes at src
+static bool str_glob_at(const str_glob_t *glob, const str_glob_seg_t *seg, const char *src) {
+    if (seg->literal) {
+        return memcmp(glob->bytes + seg->start, src, seg->length) == 0;
+    }
+    for (size_t i = 0; i < seg->length; i++) {
+        if (!str_re_set_has(&glob->sets[seg->start + i], (unsigned char)src[i])) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    size_t index = 0;
-    size_t curr = 0;
-    if (step > 0) {
-        for (size_t i = 0; i < sub_len;) {
-            memcpy(&result[index], &ptr[curr], info[i]);
-            index += info[i];
-            for (size_t j = 0; j < abs_step; j++) {
-                if (i < sub_len) {
-                    if (i <= sub_len) {
-                        curr -= info[i];
-                        i--;
-                    }
-                }
+// return the index of the leftmost place seg matches in src, or -1
+static int64_t str_glob_find(const str_glob_t *glob, const str_glob_seg_t *seg, const char *src, size_t length) {
+    if (seg->literal) {
+        const char *hit = str_memmem(src, length, glob->bytes + seg->start, seg->length);
+        return hit != NULL ? hit - src : -1;
+    }
+    if (seg->length <= 64) {
+        uint64_t state = 0;
+        uint64_t accept = 1ull << (seg->length - 1);
+        for (size_t i = 0; i < length; i++) {
+            state = ((state << 1) | 1) & seg->masks[(unsigned char)src[i]];
+            if (state & accept) {
+                return (int64_t)(i + 1 - seg->length);
             }
         }
-    } else {
-        curr = str - ptr - info[sub_len - 1];
-        // i <= sub_len for unsigned integer overflow
-        for (size_t i = sub_len - 1; i <= sub_len;) {
-            memcpy(&result[index], &ptr[curr], info[i]);
-            index += info[i];
-            for (size_t j = 0; j < abs_step; j++) {
-                curr -= info[i];
-                i--;
+        return -1;
+    }
+    // the state of a longer segment fits on the stack up to 256 bytes
+    size_t words = (seg->length + 63) / 64;
+    size_t top = words - 1;
+    uint64_t accept = 1ull << ((seg->length - 1) % 64);
+    uint64_t small[4];
+    uint64_t *state = words <= 4 ? small : str_raw_alloc(glob->allocator, sizeof(uint64_t) * words);
+    if (state != NULL) {
+        memset(state, 0, sizeof(uint64_t) * words);
+        int64_t index = -1;
+        for (size_t i = 0; i < length && index < 0; i++) {
+            const uint64_t *mask = seg->masks + (unsigned char)src[i] * words;
+            uint64_t carry = 1;
+            for (size_t w = 0; w < words; w++) {
+                uint64_t value = state[w];
+                state[w] = ((value << 1) | carry) & mask[w];
+                carry = value >> 63;
             }
+            if (state[top] & accept) {
+                index = (int64_t)(i + 1 - seg->length);
+            }
+        }
+        if (state != small) {
+            str_raw_free(glob->allocator, state);
         }
+        return index;
     }
-
-    if (str_resize(self, total_size)) {
-        memcpy((*self)->cstr, result, total_size);
-        (*self)->cstr[(*self)->length] = 0;
-#if defined(__STDC_NO_VLA__)
-        free(result);
-        free(info);
-#endif
-        return (*self);
+    // without memory for the state, try every position
+    for (size_t i = 0; i + seg->length <= length; i++) {
+        if (str_glob_at(glob, seg, src + i)) {
+            return (int64_t)i;
+        }
     }
-#if defined(__STDC_NO_VLA__)
-    free(result);
-    free(info);
-#endif
-    return NULL;
+    return -1;
 }
 
-int64_t str_find(const string_t *src, const char *needle, size_t number) {
-    if (number == 0) {
-        return -1;
+bool str_glob_test(const str_glob_t *glob, str_view_t src) {
+    const str_glob_seg_t *first = &glob->segs[0];
+    const str_glob_seg_t *last = &glob->segs[glob->seg_count - 1];
+    if (glob->seg_count == 1) {
+        return src.length == first->length && str_glob_at(glob, first, src.data);
     }
-    const char *ptr = src->cstr;
-    for (size_t i = 0; i < number; i++) {
-        ptr = strstr(ptr, needle);
-        if (ptr == NULL) {
-            return -1;
+    if (src.length < glob->min_length || !str_glob_at(glob, first, src.data) || !str_glob_at(glob, last, src.data + src.length - last->length)) {
+        return false;
+    }
+    size_t lo = first->length;
+    size_t hi = src.length - last->length;
+    for (size_t i = 1; i + 1 < glob->seg_count; i++) {
+        const str_glob_seg_t *seg = &glob->segs[i];
+        int64_t index = str_glob_find(glob, seg, src.data + lo, hi - lo);
+        if (index < 0) {
+            return false;
         }
+        lo += (size_t)index + seg->length;
     }
-    return (int64_t)(ptr - src->cstr);
+    return true;
 }
 
-int64_t str_utf8_find(const string_t *src, const char *needle, size_t number) {
-    if (number == 0) {
-        return -1;
+bool str_glob_match(const string_t *src, const char *pattern) {
+    str_glob_t *glob = str_glob_new(pattern);
+    if (glob == NULL) {
+        return false;
     }
-    const char *ptr = src->cstr;
-    for (size_t i = 0; i < number; i++) {
-        ptr = strstr(ptr, needle);
-        if (ptr == NULL) {
-            return -1;
-        }
+    bool result = str_glob_test(glob, str_view(src));
+    str_glob_free(glob);
+    return result;
+}
+
+// edit distances work on bytes. a pattern of at most 64 bytes runs bit-parallel
+// with one word per column of the dp matrix, longer ones fall back to a dp
+// restricted to a band around the diagonal that is doubled until the distance
+// fits inside it
+
+// myers' algorithm, peq has a bit set for every position of a byte in the
+// pattern of length m, 1 <= m <= 64
+static size_t str_myers(const uint64_t *peq, size_t m, const char *text, size_t n) {
+    uint64_t vp = ~0ull;
+    uint64_t vn = 0;
+    uint64_t last = 1ull << (m - 1);
+    size_t score = m;
+    for (size_t j = 0; j < n; j++) {
+        uint64_t eq = peq[(unsigned char)text[j]];
+        uint64_t d0 = (((eq & vp) + vp) ^ vp) | eq | vn;
+        uint64_t hp = vn | ~(d0 | vp);
+        uint64_t hn = d0 & vp;
+        score += (hp & last) != 0;
+        score -= (hn & last) != 0;
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
     }
-    int64_t index = ptr - src->cstr;
+    return score;
+}
 
-    int64_t length = 0;
-    int64_t current_char = 0;
-    while (length <= index) {
-        if (*ptr == 0) {
-            return current_char;
-        } else if ((*ptr & 0x80) == 0) {
-            ptr++;
-            length++;
-        } else if ((*ptr & 0xE0) == 0xC0) {
-            ptr += 2;
-            length += 2;
-        } else if ((*ptr & 0xF0) == 0xE0) {
-            ptr += 3;
-            length += 3;
-        } else if ((*ptr & 0xF8) == 0xF0) {
-            ptr += 4;
-            length += 4;
+// hyyro's extension of myers' algorithm to adjacent transpositions, which
+// gives the optimal string alignment distance
+static size_t str_myers_damerau(const uint64_t *peq, size_t m, const char *text, size_t n) {
+    uint64_t vp = ~0ull;
+    uint64_t vn = 0;
+    uint64_t d0 = 0;
+    uint64_t prev_eq = 0;
+    uint64_t last = 1ull << (m - 1);
+    size_t score = m;
+    for (size_t j = 0; j < n; j++) {
+        uint64_t eq = peq[(unsigned char)text[j]];
+        uint64_t tr = (((~d0) & eq) << 1) & prev_eq;
+        d0 = (((eq & vp) + vp) ^ vp) | eq | vn | tr;
+        uint64_t hp = vn | ~(d0 | vp);
+        uint64_t hn = d0 & vp;
+        score += (hp & last) != 0;
+        score -= (hn & last) != 0;
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
+        prev_eq = eq;
+    }
+    return score;
+}
+
+// dp over the cells at most k off the diagonal, anything above k is clamped to
+// k + 1. rows has room for three rows of m + 1
+static size_t str_banded(const char *a, size_t n, const char *b, size_t m, size_t k, bool transpose, size_t *rows) {
+    size_t limit = k + 1;
+    size_t *prev2 = rows;
+    size_t *prev = rows + m + 1;
+    size_t *cur = rows + 2 * (m + 1);
+    for (size_t j = 0; j <= m; j++) {
+        prev[j] = j < limit ? j : limit;
+    }
+    for (size_t i = 1; i <= n; i++) {
+        size_t lo = i > k ? i - k : 0;
+        size_t hi = i + k < m ? i + k : m;
+        if (lo > hi) {
+            return limit;
+        }
+        if (lo == 0) {
+            cur[0] = i;
+            lo = 1;
         } else {
+            cur[lo - 1] = limit;
+        }
+        for (size_t j = lo; j <= hi; j++) {
+            size_t value = prev[j - 1] + (a[i - 1] != b[j - 1]);
+            if (prev[j] + 1 < value) {
+                value = prev[j] + 1;
+            }
+            if (cur[j - 1] + 1 < value) {
+                value = cur[j - 1] + 1;
+            }
+            if (transpose && i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] && prev2[j - 2] + 1 < value) {
+                value = prev2[j - 2] + 1;
+            }
+            cur[j] = value < limit ? value : limit;
+        }
+        if (hi < m) {
+            cur[hi + 1] = limit;
+        }
+        size_t *temp = prev2;
+        prev2 = prev;
+        prev = cur;
+        cur = temp;
+    }
+    return prev[m];
+}
+
+static size_t str_edit_distance(const string_t *str1, const string_t *str2, bool transpose) {
+    const char *a = str1->cstr;
+    const char *b = str2->cstr;
+    size_t n = str1->length;
+    size_t m = str2->length;
+    // a shared prefix or suffix never takes an edit
+    while (n != 0 && m != 0 && *a == *b) {
+        a++, b++, n--, m--;
+    }
+    while (n != 0 && m != 0 && a[n - 1] == b[m - 1]) {
+        n--, m--;
+    }
+    if (m > n) {
+        const char *temp = a;
+        a = b;
+        b = temp;
+        size_t length = n;
+        n = m;
+        m = length;
+    }
+    if (m == 0) {
+        return n;
+    }
+    if (m <= 64) {
+        uint64_t peq[256] = {0};
+        for (size_t i = 0; i < m; i++) {
+            peq[(unsigned char)b[i]] |= 1ull << i;
+        }
+        return transpose ? str_myers_damerau(peq, m, a, n) : str_myers(peq, m, a, n);
+    }
+    const str_allocator_t *allocator = str_get_allocator();
+    size_t *rows = str_raw_alloc(allocator, sizeof(size_t) * 3 * (m + 1));
+    if (rows == NULL) {
 #ifdef YASLI_DEBUG
-            return (fputs("[ERRO]: invalid utf-8 sequence\n", stderr), 0);
+        return (fputs("[ERRO]: out of memory\n", stderr), SIZE_MAX);
 #else
-            return 0;
+        return SIZE_MAX;
 #endif
+    }
+    // the distance is at least n - m, and a band of n is the whole matrix
+    size_t distance;
+    for (size_t k = n - m + 32;; k *= 2) {
+        distance = str_banded(a, n, b, m, k, transpose, rows);
+        if (distance <= k || k >= n) {
+            break;
         }
-        current_char++;
     }
-    return current_char;
+    str_raw_free(allocator, rows);
+    return distance;
 }
 
-string_t *str_removed(const string_t *src, size_t index, size_t length) {
-    if (src == NULL) {
+size_t str_levenshtein(const string_t *str1, const string_t *str2) {
+    return str_edit_distance(str1, str2, false);
+}
+
+size_t str_damerau(const string_t *str1, const string_t *str2) {
+    return str_edit_distance(str1, str2, true);
+}
+
+size_t *str_levenshtein_arr(const string_t *query, string_t **arr, size_t size) {
+    size_t *distances = str_mem_alloc(sizeof(size_t) * (size != 0 ? size : 1));
+    if (distances == NULL) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: input is NULL\n", stderr), NULL);
+        return (fputs("[ERRO]: out of memory\n", stderr), NULL);
 #else
         return NULL;
 #endif
     }
-    if (index + length > src->length) {
+    size_t m = query->length;
+    if (m == 0 || m > 64) {
+        for (size_t i = 0; i < size; i++) {
+            distances[i] = str_levenshtein(query, arr[i]);
+        }
+        return distances;
+    }
+    // the query is the pattern, so its bit masks are built once for all
+    uint64_t peq[256] = {0};
+    for (size_t i = 0; i < m; i++) {
+        peq[(unsigned char)query->cstr[i]] |= 1ull << i;
+    }
+    for (size_t i = 0; i < size; i++) {
+        distances[i] = str_myers(peq, m, arr[i]->cstr, arr[i]->length);
+    }
+    return distances;
+}
+
+double str_jaro_winkler(const string_t *str1, const string_t *str2) {
+    const char *a = str1->cstr;
+    const char *b = str2->cstr;
+    size_t n = str1->length;
+    size_t m = str2->length;
+    if (n == 0 || m == 0) {
+        return n == m ? 1.0 : 0.0;
+    }
+    size_t window = (n > m ? n : m) / 2;
+    window = window != 0 ? window - 1 : 0;
+    size_t matches = 0;
+    size_t transpositions = 0;
+    if (m <= 64) {
+        // every byte of a takes the first unmatched equal byte of b in its
+        // window, found with a mask instead of a scan
+        uint64_t peq[256] = {0};
+        for (size_t j = 0; j < m; j++) {
+            peq[(unsigned char)b[j]] |= 1ull << j;
+        }
+        uint64_t matched = 0;
+        char order[64];
+        for (size_t i = 0; i < n && matches < m; i++) {
+            size_t lo = i > window ? i - window : 0;
+            size_t hi = i + window + 1 < m ? i + window + 1 : m;
+            if (lo >= hi) {
+                continue;
+            }
+            uint64_t range = (hi == 64 ? ~0ull : (1ull << hi) - 1) & ~((1ull << lo) - 1);
+            uint64_t candidates = peq[(unsigned char)a[i]] & range & ~matched;
+            if (candidates != 0) {
+                matched |= candidates & (~candidates + 1);
+                order[matches++] = a[i];
+            }
+        }
+        for (size_t j = 0, k = 0; j < m; j++) {
+            if ((matched >> j) & 1) {
+                transpositions += order[k++] != b[j];
+            }
+        }
+    } else {
+        const str_allocator_t *allocator = str_get_allocator();
+        char *matched_a = str_raw_alloc(allocator, n + m);
+        if (matched_a == NULL) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+            return (fputs("[ERRO]: out of memory\n", stderr), -1.0);
 #else
-        return NULL;
+            return -1.0;
 #endif
+        }
+        char *matched_b = matched_a + n;
+        memset(matched_a, 0, n + m);
+        for (size_t i = 0; i < n; i++) {
+            size_t lo = i > window ? i - window : 0;
+            size_t hi = i + window + 1 < m ? i + window + 1 : m;
+            for (size_t j = lo; j < hi; j++) {
+                if (!matched_b[j] && a[i] == b[j]) {
+                    matched_a[i] = matched_b[j] = 1;
+                    matches++;
+                    break;
+                }
+            }
+        }
+        // pair the matched bytes of both strings up in order
+        for (size_t i = 0, j = 0; i < n; i++) {
+            if (matched_a[i]) {
+                while (!matched_b[j]) {
+                    j++;
+                }
+                transpositions += a[i] != b[j++];
+            }
+        }
+        str_raw_free(allocator, matched_a);
     }
-    string_t *result = NULL;
-    if (str_resize(&result, src->length - length)) {
-        memmove(result->cstr, src->cstr, index);
-        memmove(result->cstr + index, src->cstr + index + length, src->length - index - length);
-        result->cstr[result->length] = 0;
-        return result;
+    if (matches == 0) {
+        return 0.0;
     }
-    return NULL;
+    double jaro = ((double)matches / n + (double)matches / m + (matches - transpositions / 2.0) / matches) / 3.0;
+    if (jaro <= 0.7) {
+        return jaro;
+    }
+    // winkler's boost for a common prefix of up to 4 bytes
+    size_t prefix = 0;
+    while (prefix < 4 && prefix < n && prefix < m && a[prefix] == b[prefix]) {
+        prefix++;
+    }
+    return jaro + prefix * 0.1 * (1.0 - jaro);
 }
 
-string_t *str_remove(string_t **self, size_t index, size_t length) {
-    if ((*self) == NULL) {
+// approximate search runs wu and manber's bitap: row d holds a bit for every
+// prefix of the needle that ends at the current byte with at most d edits. a
+// needle longer than 64 bytes spreads each row over several words. the first
+// end with at most k edits is moved on while the next byte gives fewer, then
+// a small dp backwards from there picks the start
+
+// advance the rows over a byte whose masks are eq. old and saved are scratch
+// for a row each
+static void str_bitap_step(uint64_t *rows, size_t words, size_t k, const uint64_t *eq, uint64_t *old, uint64_t *saved) {
+    for (size_t d = 0; d <= k; d++) {
+        uint64_t *row = rows + d * words;
+        uint64_t carry = 1;
+        uint64_t carry_above = 1;
+        for (size_t w = 0; w < words; w++) {
+            uint64_t value = row[w];
+            saved[w] = value;
+            uint64_t next = ((value << 1) | carry) & eq[w];
+            carry = value >> 63;
+            if (d != 0) {
+                // a substitution or a deleted needle byte moves one position on,
+                // an inserted text byte stays in place
+                uint64_t moved = old[w] | rows[(d - 1) * words + w];
+                next |= (moved << 1) | carry_above | old[w];
+                carry_above = moved >> 63;
+            }
+            row[w] = next;
+        }
+        uint64_t *temp = old;
+        old = saved;
+        saved = temp;
+    }
+}
+
+// smallest d whose row has the whole needle, k + 1 if none does
+static size_t str_bitap_edits(const uint64_t *rows, size_t words, size_t k, size_t m) {
+    size_t top = (m - 1) / 64;
+    uint64_t last = 1ull << ((m - 1) % 64);
+    // rows only grow with d, so the last one tells if any has a match
+    if (!(rows[k * words + top] & last)) {
+        return k + 1;
+    }
+    size_t d = 0;
+    while (!(rows[d * words + top] & last)) {
+        d++;
+    }
+    return d;
+}
+
+// index of the match found by bitap in text[from, n) or -1, end gets where it
+// ends
+static int64_t str_approx(const char *text, size_t n, size_t from, const char *needle, size_t m, size_t k, size_t *end) {
+    if (m == 0) {
+        *end = from;
+        return (int64_t)from;
+    }
+    // with m edits the whole needle is deleted, more never help
+    if (k > m) {
+        k = m;
+    }
+    size_t words = (m + 63) / 64;
+    // the masks, the rows, two scratch rows and the dp column, which fit on
+    // the stack for a needle of one word
+    uint64_t small[256 + 65 + 2 + 65];
+    uint64_t *memory = small;
+    const str_allocator_t *allocator = str_get_allocator();
+    if (words != 1) {
+        memory = str_raw_alloc(allocator, sizeof(uint64_t) * ((256 + k + 3) * words + m + 1));
+        if (memory == NULL) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: input is NULL\n", stderr), NULL);
+            return (fputs("[ERRO]: out of memory\n", stderr), -1);
 #else
-        return NULL;
+            return -1;
 #endif
+        }
     }
-    if (index + length > (*self)->length) {
+    uint64_t *peq = memory;
+    uint64_t *rows = peq + 256 * words;
+    uint64_t *old = rows + (k + 1) * words;
+    uint64_t *saved = old + words;
+    memset(peq, 0, sizeof(uint64_t) * (256 + k + 1) * words);
+    for (size_t i = 0; i < m; i++) {
+        peq[(unsigned char)needle[i] * words + i / 64] |= 1ull << (i % 64);
+    }
+    // the first d bytes of the needle can always be deleted
+    for (size_t d = 1; d <= k; d++) {
+        for (size_t i = 0; i < d; i++) {
+            rows[d * words + i / 64] |= 1ull << (i % 64);
+        }
+    }
+    int64_t index = -1;
+    size_t pos = from;
+    size_t edits = str_bitap_edits(rows, words, k, m);
+    if (words == 1 && edits > k) {
+        // the scan for the first match is the hot loop, keep a one word needle
+        // out of the generic step
+        uint64_t last = 1ull << (m - 1);
+        while (pos < n) {
+            uint64_t eq = peq[(unsigned char)text[pos++]];
+            uint64_t above = rows[0];
+            rows[0] = ((above << 1) | 1) & eq;
+            for (size_t d = 1; d <= k; d++) {
+                uint64_t value = rows[d];
+                rows[d] = (((value << 1) | 1) & eq) | ((above | rows[d - 1]) << 1) | 1 | above;
+                above = value;
+            }
+            if (rows[k] & last) {
+                break;
+            }
+        }
+        edits = str_bitap_edits(rows, words, k, m);
+    }
+    for (; edits > k && pos < n; pos++) {
+        str_bitap_step(rows, words, k, peq + (unsigned char)text[pos] * words, old, saved);
+        edits = str_bitap_edits(rows, words, k, m);
+    }
+    if (edits <= k) {
+        for (; pos < n; pos++) {
+            str_bitap_step(rows, words, k, peq + (unsigned char)text[pos] * words, old, saved);
+            size_t next = str_bitap_edits(rows, words, k, m);
+            if (next >= edits) {
+                break;
+            }
+            edits = next;
+        }
+        // levenshtein distance of the needle to every suffix of the text up to
+        // pos, both read backwards. the best start is the leftmost of the
+        // smallest ones
+        size_t *column = (size_t *)(saved + words);
+        size_t lo = pos - from > m + k ? pos - m - k : from;
+        for (size_t i = 0; i <= m; i++) {
+            column[i] = i;
+        }
+        size_t best = column[m];
+        index = (int64_t)pos;
+        for (size_t t = 1; t <= pos - lo; t++) {
+            size_t diagonal = column[0];
+            column[0] = t;
+            for (size_t i = 1; i <= m; i++) {
+                size_t value = diagonal + (needle[m - i] != text[pos - t]);
+                if (column[i] + 1 < value) {
+                    value = column[i] + 1;
+                }
+                if (column[i - 1] + 1 < value) {
+                    value = column[i - 1] + 1;
+                }
+                diagonal = column[i];
+                column[i] = value;
+            }
+            if (column[m] <= best) {
+                best = column[m];
+                index = (int64_t)(pos - t);
+            }
+        }
+        *end = pos;
+    }
+    if (memory != small) {
+        str_raw_free(allocator, memory);
+    }
+    return index;
+}
+
+int64_t str_find_approx(const string_t *src, const char *needle, size_t k, size_t start, size_t *length) {
+    if (start > src->length) {
 #ifdef YASLI_DEBUG
-        return (fputs("[ERRO]: index out of bounds\n", stderr), NULL);
+        return (fputs("[ERRO]: index out of bound\n", stderr), -1);
 #else
-        return NULL;
+        return -1;
 #endif
     }
-    memmove((*self)->cstr + index, (*self)->cstr + index + length, (*self)->length - index - length);
-    if (str_resize(self, (*self)->length - length)) {
-        (*self)->cstr[(*self)->length] = 0;
-        return (*self);
+    size_t end;
+    int64_t index = str_approx(src->cstr, src->length, start, needle, strlen(needle), k, &end);
+    if (index >= 0 && length != NULL) {
+        *length = end - (size_t)index;
+    }
+    return index;
+}
+
+str_view_t *str_find_approx_all(const string_t *src, const char *needle, size_t k, size_t *count) {
+    size_t cap = 16;
+    size_t index = 0;
+    str_view_t *matches = str_mem_alloc(sizeof(str_view_t) * cap);
+    if (matches == NULL) {
+        goto oom;
+    }
+    size_t nlen = strlen(needle);
+    size_t start = 0;
+    size_t end;
+    for (int64_t found; start <= src->length && (found = str_approx(src->cstr, src->length, start, needle, nlen, k, &end)) >= 0;) {
+        // one slot is always left for the terminating view
+        if (index + 2 > cap) {
+            str_view_t *result = str_mem_realloc(matches, sizeof(str_view_t) * cap, sizeof(str_view_t) * cap * 2);
+            if (result == NULL) {
+                str_mem_free(matches);
+                goto oom;
+            }
+            matches = result;
+            cap *= 2;
+        }
+        matches[index++] = (str_view_t){src->cstr + found, end - (size_t)found};
+        // an empty match would be found again at the same place
+        start = end != (size_t)found ? end : end + 1;
     }
+    matches[index] = (str_view_t){NULL, 0};
+    if (count != NULL) {
+        *count = index;
+    }
+    return matches;
+oom:
+#ifdef YASLI_DEBUG
+    return (fputs("[ERRO]: out of memory\n", stderr), NULL);
+#else
     return NULL;
+#endif
+}
+
+uint64_t str_hash(const string_t *src) {
+    return str_hash_bytes(src->cstr, src->length, 0);
+}
+
+uint64_t str_hash_seed(const string_t *src, uint64_t seed) {
+    return str_hash_bytes(src->cstr, src->length, seed);
 }
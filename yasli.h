@@ -5,6 +5,7 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,6 +15,13 @@
 // user should never change the value of length or capacity in the code.
 typedef struct string_t string_t, *str_t;
 
+// a pointer and a length into memory owned by someone else, only valid as
+// long as that memory is. data is not null terminated
+typedef struct str_view_t {
+    const char* data;
+    size_t length;
+} str_view_t;
+
 #define YASLI_START INT64_MIN
 #define YASLI_END   INT64_MAX
 
@@ -30,7 +38,8 @@ size_t str_capacity(const string_t* string);
 const char* str_cstr(const string_t* string);
 
 // get a wchar_t string from string, user free, probably useful on windows?
-// use str_free to free the returned result
+// use str_free, not free, to free the returned result. it comes from the
+// arena when one is in use
 const wchar_t* str_wstr(const string_t* string);
 
 // constructor
@@ -54,6 +63,77 @@ string_t* str_new_string_narr(const char** src, size_t size);
 // free memory allocated by string internally
 void str_free(void* string);
 
+// a growth policy returns the capacity for a string that has room for
+// capacity bytes and needs room for at least required bytes
+typedef size_t (*str_growth_t)(size_t capacity, size_t required);
+
+// powers of two up to 1024, then steps of 512
+size_t str_grow_default(size_t capacity, size_t required);
+
+// double the capacity
+size_t str_grow_2x(size_t capacity, size_t required);
+
+// grow the capacity by half
+size_t str_grow_1_5x(size_t capacity, size_t required);
+
+// str_grow_default up to a page, then grow by half and round the allocation
+// up to whole 4096 byte pages
+size_t str_grow_page(size_t capacity, size_t required);
+
+// set the growth policy of every string, NULL goes back to str_grow_default.
+// not thread safe, set it before starting other threads
+void str_set_growth(str_growth_t growth);
+
+// false keeps strings from ever giving memory back on their own, only
+// str_shrink_to_fit does. true, the default, lets a string shrink once it
+// uses no more than a quarter of its capacity. not thread safe
+void str_set_shrink(bool shrink);
+
+// runtime replacement for malloc, realloc and free. ctx is handed to every
+// call. a string remembers the allocator it came from, so the allocator must
+// stay alive until every string allocated with it is freed
+typedef struct str_allocator_t {
+    void* (*alloc)(void* ctx, size_t size);
+    void* (*realloc)(void* ctx, void* ptr, size_t size);
+    void (*free)(void* ctx, void* ptr);
+    void* ctx;
+} str_allocator_t;
+
+// set the allocator of every thread that has no allocator of its own, NULL
+// goes back to malloc. not thread safe, set it before starting other threads
+void str_set_allocator(const str_allocator_t* allocator);
+
+// set the allocator of the current thread, NULL falls back to the global one
+void str_set_thread_allocator(const str_allocator_t* allocator);
+
+// get the allocator in effect for the current thread, NULL means malloc
+const str_allocator_t* str_get_allocator(void);
+
+// an arena hands out memory for many strings and releases them all at once
+typedef struct str_arena_t str_arena_t;
+
+// create an arena that takes memory from the current allocator in chunks of
+// chunk_size bytes, 0 picks a default chunk size
+str_arena_t* str_arena_new(size_t chunk_size);
+
+// release the arena and every string, array or buffer allocated from it
+void str_arena_free(str_arena_t* arena);
+
+// release everything allocated from the arena, but keep the arena for reuse
+void str_arena_reset(str_arena_t* arena);
+
+// make every following allocation of the current thread come from arena, use
+// NULL to go back to the heap. returns the arena that was in use before.
+// str_free on a string from an arena does nothing.
+str_arena_t* str_arena_use(str_arena_t* arena);
+
+// give the slabs of short strings of the current thread, and with YASLI_POOL
+// the free blocks it caches, back to the system. a slab still holding strings
+// goes away with the last of them. both are given back by themselves when the
+// thread exits, unless the compiler has no c11 threads, then every thread has
+// to call this before it exits
+void str_pool_trim(void);
+
 // free multiple string at once, the last argument should be NULL
 void str_frees(string_t* string, ...);
 
@@ -71,8 +151,12 @@ bool str_clear(string_t** string);
 // e.g.: str = str_clear_to( str, str_new_format( "random string" ) );
 string_t* str_clear_to(string_t* old, string_t* new_str);
 
-// reserve memory that can hold at least length char, length+1 if count '\0'
-bool str_reserve(string_t* string, size_t length);
+// reserve memory that can hold at least length char, length+1 if count '\0'.
+// the string may move, so its address is updated
+bool str_reserve(string_t** string, size_t length);
+
+// shrink the capacity to exactly what the string needs
+bool str_shrink_to_fit(string_t** string);
 
 // append two strings together to a new string_t. return NULL when failure
 string_t* str_appended(const string_t* start, const string_t* end);
@@ -102,23 +186,39 @@ string_t* str_appended_cstrs(const string_t* start, ...);
 string_t* str_append_cstrs(string_t** start, ...);
 
 // split src string upon needle string, returns an array of string_t with the
-// last element being NULL caller free, use `str_destroy_string_arr` to free the
+// last element being NULL caller free, use `str_free_arr` to free the
 // returned array
 string_t** str_split(const string_t* src, const char* needle);
 
-// set all the characters to upper case, UB if special characters
+// same as str_split, but the array and its tokens share one allocation. a
+// token goes away with the array, so str_free on it does nothing and it must
+// be copied with `str_strdup` if it has to outlive the array
+string_t** str_split_packed(const string_t* src, const char* needle);
+
+// set all the characters to upper case, UB if special characters. a string
+// shared under YASLI_REFCOUNT is left unchanged, use str_upper for it
 void str_to_upper(string_t* string);
 
-// set all the characters to lower case, UB if special characters
+// set all the characters to lower case, UB if special characters. a string
+// shared under YASLI_REFCOUNT is left unchanged, use str_lower for it
 void str_to_lower(string_t* string);
 
+// same as str_to_upper, but a shared string is copied first. return self, or
+// NULL when failure
+string_t* str_upper(string_t** self);
+
+// same as str_to_lower, but a shared string is copied first. return self, or
+// NULL when failure
+string_t* str_lower(string_t** self);
+
 // return a substr starting from index start, with size size
 string_t* str_substr(const string_t* src, size_t start, size_t size);
 
 // create a substr that treat every character as an utf-8 encoding character
 string_t* str_utf8_substr(const string_t* src, size_t start, size_t size);
 
-// copy a string, return a new string
+// copy a string, return a new string. with YASLI_REFCOUNT the copy shares
+// memory with src until one of them is changed through a string_t**
 string_t* str_strdup(const string_t* src);
 
 // insert a c string into src at index index, returning the new string
@@ -155,10 +255,33 @@ bool str_end_with(const string_t* self, const char* str);
 // return if the substring presents in the string_t
 bool str_has(const string_t* self, const char* str);
 
+// the case insensitive versions fold ascii letters only and ignore the locale,
+// comparing many bytes at a time with SSE2 or AVX2
+
+// same as str_find, but ignore ascii case
+int64_t str_ifind(const string_t* src, const char* needle, size_t number);
+
+// same as str_has, but ignore ascii case
+bool str_ihas(const string_t* self, const char* str);
+
+// same as str_start_with, but ignore ascii case
+bool str_istart_with(const string_t* self, const char* str);
+
+// same as str_end_with, but ignore ascii case
+bool str_iend_with(const string_t* self, const char* str);
+
+// same as str_streq, but ignore ascii case
+bool str_istreq(const string_t* str1, const string_t* str2);
+
 // if new_val is 0, return the character at index index. Otherwise change that
-// character to new_val
+// character to new_val. a string shared under YASLI_REFCOUNT is not changed
+// and 0 is returned, use str_set_char_at for it
 char str_char_at(string_t* self, size_t index, char new_val);
 
+// change the character at index index to new_val, copying a shared string
+// first. return self, or NULL when failure
+string_t* str_set_char_at(string_t** self, size_t index, char new_val);
+
 // return a new stripped string_t
 string_t* str_stripped(const string_t* src, const char* needle);
 
@@ -203,16 +326,371 @@ string_t* str_utf8_sliced(const string_t* src, int64_t start, int64_t end, int64
 // slice, change the original string, take input as an utf-8 encoded string
 string_t* str_utf8_slice(string_t** self, int64_t start, int64_t end, int64_t step);
 
-// get the index of specific sub string
+// get the index of the number-th occurrence of needle, counting from 1,
+// occurrences do not overlap. -1 if there is none
 int64_t str_find(const string_t* src, const char* needle, size_t number);
 
 // get the utf-8 index of specific sub string
 int64_t str_utf8_find(const string_t* src, const char* needle, size_t number);
 
+// get the index of the number-th occurrence of needle counting from the end,
+// starting from 1. occurrences do not overlap. -1 if there is none
+int64_t str_rfind(const string_t* src, const char* needle, size_t number);
+
+// get the utf-8 index of the number-th occurrence of needle counting from the
+// end
+int64_t str_utf8_rfind(const string_t* src, const char* needle, size_t number);
+
+// find every occurrence of needle in one pass and store their indices in
+// *offsets, returning how many there are or -1 on failure. *offsets has to be
+// NULL or an array from an earlier call with *capacity elements, it grows as
+// needed and *capacity follows. reuse it for the next call and use str_free to
+// free it. occurrences overlap only if overlapping is true
+int64_t str_find_all(const string_t* src, const char* needle, bool overlapping, size_t** offsets, size_t* capacity);
+
 // remove starting from index, of size length
 string_t* str_removed(const string_t* src, size_t index, size_t length);
 
 // remove starting from index, of size length
 string_t* str_remove(string_t** self, size_t index, size_t length);
 
+// view of the whole string
+str_view_t str_view(const string_t* src);
+
+// view of a null terminated c string
+str_view_t str_view_cstr(const char* src);
+
+// view of size bytes starting from index start, data is NULL if out of bound
+str_view_t str_view_substr(str_view_t src, size_t start, size_t size);
+
+// construct a new string from a view
+string_t* str_new_view(str_view_t src);
+
+// get the index of the number-th occurrence of needle, -1 if there is none.
+// occurrences do not overlap
+int64_t str_view_find(str_view_t src, str_view_t needle, size_t number);
+
+// same as str_view_find, but count occurrences from the end
+int64_t str_view_rfind(str_view_t src, str_view_t needle, size_t number);
+
+// split src upon needle into views of src, without copying anything. all the
+// views are stored in one array that ends with a view whose data is NULL. if
+// count is not NULL, it gets the number of views. use str_free to free the
+// array
+str_view_t* str_view_split(str_view_t src, str_view_t needle, size_t* count);
+
+// return if needle presents in src
+bool str_view_has(str_view_t src, str_view_t needle);
+
+// return if src start with prefix
+bool str_view_start_with(str_view_t src, str_view_t prefix);
+
+// return if src end with suffix
+bool str_view_end_with(str_view_t src, str_view_t suffix);
+
+// compare views byte by byte, 0 means the same, a prefix sorts first
+int str_view_strcmp(str_view_t str1, str_view_t str2);
+
+// test if views are equal
+bool str_view_streq(str_view_t str1, str_view_t str2);
+
+// an intern pool keeps one canonical string per content
+typedef struct str_intern_t str_intern_t;
+
+// create an empty intern pool. not thread safe, use one pool per thread or
+// lock around it
+str_intern_t* str_intern_new(void);
+
+// release the pool and all of its canonical strings, NULL releases the global
+// pool
+void str_intern_free(str_intern_t* pool);
+
+// return the canonical string with the content of src, adding it to the pool
+// if needed. NULL as pool uses a global pool. the returned string belongs to
+// the pool, str_free on it does nothing. canonical strings of one pool can be
+// compared by address, str_streq does so
+const string_t* str_intern(str_intern_t* pool, const char* src);
+
+// same as str_intern, but take the content from a string_t
+const string_t* str_intern_string(str_intern_t* pool, const string_t* src);
+
+// return the id of the content of src in the pool, or -1 if it is not
+// interned. ids are dense and given out in order, starting from 0
+int64_t str_intern_id(str_intern_t* pool, const string_t* src);
+
+// return the canonical string with id id, NULL if there is none
+const string_t* str_intern_at(str_intern_t* pool, size_t id);
+
+// return the number of strings in the pool
+size_t str_intern_count(const str_intern_t* pool);
+
+// a rope keeps a long text as a balanced tree of chunks, so that inserting,
+// removing, taking a substring or concatenating costs O(log n) instead of
+// moving the whole tail. the chunks are shared between ropes and never
+// modified, a substring or a concatenation copies no text. ropes that share
+// chunks must stay on one thread
+typedef struct str_rope_t str_rope_t;
+
+// construct a rope holding a copy of src
+str_rope_t* str_rope_new(const char* src);
+
+// construct a rope holding a copy of src
+str_rope_t* str_rope_from_string(const string_t* src);
+
+// free the rope, chunks still used by other ropes are kept
+void str_rope_free(str_rope_t* rope);
+
+// get the length of the rope
+size_t str_rope_length(const str_rope_t* rope);
+
+// return the character at index index, 0 if it is out of bounds
+char str_rope_char_at(const str_rope_t* rope, size_t index);
+
+// insert a c string into rope at index index. return rope, or NULL on failure
+// in which case rope is unchanged
+str_rope_t* str_rope_insert_cstr(str_rope_t* rope, size_t index, const char* in);
+
+// insert the content of in into rope at index index, without copying it
+str_rope_t* str_rope_insert(str_rope_t* rope, size_t index, const str_rope_t* in);
+
+// append a c string to rope
+str_rope_t* str_rope_append_cstr(str_rope_t* rope, const char* end);
+
+// append the content of end to rope, without copying it
+str_rope_t* str_rope_append(str_rope_t* rope, const str_rope_t* end);
+
+// remove length bytes from rope starting at index index
+str_rope_t* str_rope_remove(str_rope_t* rope, size_t index, size_t length);
+
+// return a new rope holding size bytes of src starting at index start
+str_rope_t* str_rope_substr(const str_rope_t* src, size_t start, size_t size);
+
+// return a new rope holding start followed by end
+str_rope_t* str_rope_concated(const str_rope_t* start, const str_rope_t* end);
+
+// copy the content of the rope into a new string_t
+string_t* str_rope_flatten(const str_rope_t* rope);
+
+// a gap buffer keeps free space where the last edit happened, so inserts and
+// removes close to each other cost O(1) amortized. only the distance between
+// two edits is moved, never the whole tail
+typedef struct str_gap_t str_gap_t;
+
+// construct a gap buffer holding a copy of src
+str_gap_t* str_gap_new(const char* src);
+
+// construct a gap buffer holding a copy of src
+str_gap_t* str_gap_from_string(const string_t* src);
+
+// free the gap buffer
+void str_gap_free(str_gap_t* gap);
+
+// get the length of the text in the gap buffer
+size_t str_gap_length(const str_gap_t* gap);
+
+// return the character at index index, 0 if it is out of bounds
+char str_gap_char_at(const str_gap_t* gap, size_t index);
+
+// insert a c string at index index. return gap, or NULL on failure in which
+// case the text is unchanged
+str_gap_t* str_gap_insert_cstr(str_gap_t* gap, size_t index, const char* in);
+
+// insert a string_t at index index
+str_gap_t* str_gap_insert(str_gap_t* gap, size_t index, const string_t* in);
+
+// remove length bytes starting at index index
+str_gap_t* str_gap_remove(str_gap_t* gap, size_t index, size_t length);
+
+// copy the text into a new string_t
+string_t* str_gap_flatten(const str_gap_t* gap);
+
+// a builder collects pieces in chunks that are never moved, and copies them
+// into a string_t only once at the end. useful when the pieces are not known
+// up front
+typedef struct str_builder_t str_builder_t;
+
+// construct an empty builder
+str_builder_t* str_builder_new(void);
+
+// free the builder, strings built from it are not affected
+void str_builder_free(str_builder_t* builder);
+
+// empty the builder so it can be used again, keeping some of its memory
+void str_builder_clear(str_builder_t* builder);
+
+// get the number of bytes appended so far
+size_t str_builder_length(const str_builder_t* builder);
+
+// append a string_t. return builder, or NULL on failure in which case nothing
+// is appended
+str_builder_t* str_builder_append(str_builder_t* builder, const string_t* src);
+
+// append a c string
+str_builder_t* str_builder_append_cstr(str_builder_t* builder, const char* src);
+
+// append a single character
+str_builder_t* str_builder_append_char(str_builder_t* builder, char c);
+
+// append using format string
+str_builder_t* str_builder_append_format(str_builder_t* builder, const char* format, ...);
+
+// return a new string_t holding everything appended so far. its capacity is
+// exactly its length plus the null terminator
+string_t* str_builder_build(const str_builder_t* builder);
+
+// a string table packs many strings into one block: the entries, then the
+// bytes they point to. iterating it touches contiguous memory and it is freed
+// with a single str_free
+typedef struct str_table_t str_table_t;
+
+// split src upon needle into a new table, use str_free to free it
+str_table_t* str_split_table(const string_t* src, const char* needle);
+
+// construct a table from an array of c strings, the last element of the array
+// has to be NULL. use str_free to free it
+str_table_t* str_table_new_arr(const char** src);
+
+// get the number of strings in the table
+size_t str_table_count(const str_table_t* table);
+
+// return the string at index index as a view into the table, data is null
+// terminated. out of bounds returns a view whose data is NULL
+str_view_t str_table_at(const str_table_t* table, size_t index);
+
+// sort the table in place with the same modes as str_sort. a custom compare
+// function receives pointers to str_view_t
+str_table_t* str_table_sort(str_table_t* table, const char* mode, ...);
+
+// join all the strings of the table with sep in between into a new string_t
+string_t* str_table_join(const str_table_t* table, const char* sep);
+
+// a searcher is compiled once from a needle and then runs over any number of
+// haystacks. it filters positions on the two rarest bytes of the needle with
+// SSE2 or AVX2. without them it uses memchr on the rarest byte, then horspool
+typedef struct str_searcher_t str_searcher_t;
+
+// compile a searcher for needle, which is copied
+str_searcher_t* str_searcher_new(const char* needle);
+
+// free the searcher
+void str_searcher_free(str_searcher_t* searcher);
+
+// return the index of the first occurrence of the needle in src, or -1
+int64_t str_searcher_find(const str_searcher_t* searcher, str_view_t src);
+
+// return if the needle presents in src
+bool str_searcher_has(const str_searcher_t* searcher, str_view_t src);
+
+// a multi pattern automaton finds any of many patterns in one pass over the
+// text, however many patterns there are
+typedef struct str_multi_t str_multi_t;
+
+// compile an automaton from an array of c strings, the last element of the
+// array has to be NULL. empty patterns are ignored
+str_multi_t* str_multi_new(const char** patterns);
+
+// free the automaton
+void str_multi_free(str_multi_t* multi);
+
+// return the index of the leftmost match at or after index start, the longest
+// one if several patterns match there, or -1 if there is none. if which is not
+// NULL it gets the index of the pattern that matched
+int64_t str_find_any(const str_multi_t* multi, const string_t* src, size_t start, size_t* which);
+
+// replace every match with the new value of the same index in new_vals,
+// returning a new string_t. matches are taken the way str_find_any finds them,
+// from left to right without overlapping
+string_t* str_replaced_any(const str_multi_t* multi, const string_t* src, const char** new_vals);
+
+// a compiled regular expression. it supports literals, ., [] classes with
+// ranges and negation, \d \w \s and their negations, the escapes \n \t \r
+// \f \v \0 \xHH, grouping with (), | and the repeats * + ? {m} {m,} {m,n}.
+// ^ and $ match the empty string at the start and end of the text anywhere in
+// the pattern, . matches any byte but a newline. matching is on bytes, leftmost longest, and
+// linear in the length of the text. the regex caches its dfa while searching,
+// so one regex must not be used by several threads at once
+typedef struct str_regex_t str_regex_t;
+
+// compile pattern into a regex, returns NULL on a syntax error
+str_regex_t* str_regex_new(const char* pattern);
+
+// free the regex
+void str_regex_free(str_regex_t* re);
+
+// return if the regex matches the whole of src
+bool str_regex_match(str_regex_t* re, const string_t* src);
+
+// return the index of the leftmost longest match at or after index start, or
+// -1 if there is none. if length is not NULL it gets the length of the match
+int64_t str_regex_search(str_regex_t* re, const string_t* src, size_t start, size_t* length);
+
+// return all the matches from left to right without overlapping as views into
+// src, terminated by a view whose data is NULL. if count is not NULL it gets
+// the number of matches. use str_free to free the array
+str_view_t* str_regex_find_all(str_regex_t* re, const string_t* src, size_t* count);
+
+// replace every match with new_val, returning a new string_t
+string_t* str_regex_replaced(str_regex_t* re, const string_t* src, const char* new_val);
+
+// a glob is a compiled wildcard pattern: * matches any run of bytes, ? any
+// one byte, [abc] [a-z] and [!abc] or [^abc] one byte of a class, and a
+// backslash escapes the next character. it is split on its stars into segments that are
+// found with the substring search, so testing takes linear time
+typedef struct str_glob_t str_glob_t;
+
+// compile pattern into a glob
+str_glob_t* str_glob_new(const char* pattern);
+
+// free the glob
+void str_glob_free(str_glob_t* glob);
+
+// return if the glob matches the whole of src
+bool str_glob_test(const str_glob_t* glob, str_view_t src);
+
+// return if pattern matches the whole of src, compiling it for this one test
+bool str_glob_match(const string_t* src, const char* pattern);
+
+// edit distances count bytes. a string of at most 64 bytes is compared
+// bit-parallel in linear time, longer ones by a dp restricted to a band around
+// the diagonal that widens as needed, which is fast when they are similar.
+// SIZE_MAX means out of memory
+
+// levenshtein distance, the number of inserts, deletes and substitutions that
+// turn str1 into str2
+size_t str_levenshtein(const string_t* str1, const string_t* str2);
+
+// optimal string alignment distance, levenshtein plus swaps of adjacent bytes
+size_t str_damerau(const string_t* str1, const string_t* str2);
+
+// levenshtein distance between query and each of the size strings of arr, as
+// an array of size distances. use str_free to free it
+size_t* str_levenshtein_arr(const string_t* query, string_t** arr, size_t size);
+
+// jaro-winkler similarity from 0 to 1, 1 for equal strings. a common prefix of
+// up to 4 bytes boosts scores above 0.7. -1 means out of memory
+double str_jaro_winkler(const string_t* str1, const string_t* str2);
+
+// approximate search finds the needle with at most k edits, inserts, deletes
+// or substitutions of bytes, using bitap. of the matches that end first, the
+// one with the fewest edits is taken, and of the starts for it the leftmost
+// with the fewest edits. a needle of at most 64 bytes takes one machine word
+// per edit for every byte of the text
+
+// return the index of the first approximate match at or after index start, or
+// -1 if there is none. if length is not NULL it gets the length of the match
+int64_t str_find_approx(const string_t* src, const char* needle, size_t k, size_t start, size_t* length);
+
+// return all the approximate matches from left to right without overlapping as
+// views into src, terminated by a view whose data is NULL. if count is not
+// NULL it gets the number of matches. use str_free to free the array
+str_view_t* str_find_approx_all(const string_t* src, const char* needle, size_t k, size_t* count);
+
+// 64-bit non-cryptographic hash (wyhash) of the length bytes of src, embedded
+// zeros included. fast on short keys and long ones, for hash tables and
+// sharding, not for anything an attacker controls
+uint64_t str_hash(const string_t* src);
+
+// same as str_hash, a different seed gives an unrelated hash
+uint64_t str_hash_seed(const string_t* src, uint64_t seed);
+
 #endif  // __YASLI_H__